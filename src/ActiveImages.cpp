@@ -0,0 +1,32 @@
+#include <vector>
+#include <atomic>
+#include <cstdint>
+#include <algorithm>
+
+#include "ActiveImages.h"
+
+ActiveImages::ActiveImages( int count ) : words( (count + 63) / 64 ){
+    for( int i=0; i < this->words.size(); i++ ){
+        // bits past count stay cleared
+        int bits = std::min( 64, count - i*64 );
+        uint64_t w = bits == 64 ? ~(uint64_t) 0 : ( (uint64_t) 1 << bits ) - 1;
+        this->words[i].store( w, std::memory_order_relaxed );
+    }
+}
+
+bool ActiveImages::isActive( int index ){
+    uint64_t w = this->words[ index >> 6 ].load( std::memory_order_relaxed );
+    return ( w >> (index & 63) ) & 1;
+}
+
+void ActiveImages::deactivate( int index ){
+    this->words[ index >> 6 ].fetch_and( ~( (uint64_t) 1 << (index & 63) ), std::memory_order_relaxed );
+}
+
+int ActiveImages::getActiveCount(){
+    int count = 0;
+    for( auto& w : this->words ){
+        count += __builtin_popcountll( w.load( std::memory_order_relaxed ) );
+    }
+    return count;
+}
@@ -0,0 +1,24 @@
+#ifndef ACTIVE_IMAGES_H
+#define ACTIVE_IMAGES_H
+
+#include <vector>
+#include <atomic>
+#include <cstdint>
+
+/*
+ * One bit per input image, cleared once the image has been found.
+ * Read by the match workers on every frame without locking.
+ */
+class ActiveImages{
+
+public:
+    ActiveImages( int count );
+    bool isActive( int index );
+    void deactivate( int index );
+    int getActiveCount();
+
+private:
+    std::vector< std::atomic<uint64_t> > words;
+};
+
+#endif // ACTIVE_IMAGES_H
@@ -6,8 +6,12 @@
 #include <string>
 #include <vector>
 #include <cstdio>
+#include <cmath>
 
 #include "Arguments.h"
+#include "KeyPointDetector.h"
+#include "SpatialIndex.h"
+#include "TranslationVoter.h"
 
 char Arguments::prog_doc[] = "Find frames in a video file";
 char Arguments::args_doc[] = "-i VIDEO IMAGE [IMAGE ...]";
@@ -15,14 +19,33 @@ char Arguments::args_doc[] = "-i VIDEO IMAGE [IMAGE ...]";
 struct argp_option Arguments::options[] = {
     { "min-frame",  'm',    "number",   0,  "Skip the first m frames", 0},
     { "max-frame",  'M',    "number",   0,  "Search up to the M'th frame. Default until the end of the file.", 0},
-    { "thres",      'H',    "number",   0,  "Ignored.",0},
+    { "start-time", 'b',    "ms",       0,  "Skip the video up to this time in milliseconds. Takes precedence over -m.", 0},
+    { "end-time",   'e',    "ms",       0,  "Search up to this time in milliseconds. Takes precedence over -M.", 0},
+    { "thres",      'H',    "number",   0,  "Corner threshold of the orb, fast and agast detectors, lower values find more keypoints. Default 20.",0},
+    { "detector",   'd',    "name",     0,  "Keypoint detector: orb, fast, agast, gftt or harris. Default orb.",0},
+    { "benchmark",  'X',    "frames",   0,  "Run every detector on this many frames from --min-frame and report keypoints/frame, ms/frame and match ratios, then exit.",0},
+    { "features",   'n',    "number",   0,  "Maximum number of keypoints retained per image and frame by all detectors (orb, fast, agast, gftt, harris). Default 500.",0},
+    { "levels",     'l',    "number",   0,  "Number of pyramid levels of the orb detector, 1 detects on full scale only. The other detectors work on full scale. Default 8.",0},
     { "scale",      'S',      NULL,    0,  "Scale the input images to the video's dimensions. Default false.",0},
     { "match-ratio",'r',    "float",    0,  "Minimum percentage [0-100] of image keypoint matches required to consider a frame as fully matched. Can be combined with -s. Default 100%. Repeat for each input image.", 0},
     { "snr",        's',    "float",    0,  "Minimum Signal to noise ratio [ >= 0] (keypoint matches / keypoint misses) required to consider a frame as fully matched. Can be combined with -r. Default infinity. Repeat for each input image.", 0},
     { "radius",     'R',    "float",    0,  "Radius of the circle around a keypoint of the image in which a keypoint of the frame must be to be considered a keypoint match. Default 5",0},
+    { "hit-mask",   'K',      NULL,    0,  "Rasterize the match radius around the image keypoints into a bit mask and test hits against it, rounded to whole pixels. Default false.",0},
+    { "candidates", 'c',    "float",    0,  "Count the untranslated hits of all images in one pass over a combined index and only search and vote for images reaching this percentage [0-100] of their keypoints. Breaks matching cropped videos. Default off.",0},
+    { "seed-translation",'C', NULL,    0,  "Try the last translation of each image first and only vote again when it scores clearly worse. Default false.",0},
+    { "voting",     'V',    "method",   0,  "Translation voting: hough (binned offsets, only the strongest peaks are scored) or pairwise (every offset against every other). Same result. Default hough.",0},
+    { "index",      'I',    "name",     0,  "Lookup structure for the image keypoints: kdtree or grid (cells of the match radius). Default kdtree.",0},
+    { "cache",      'A',    "DIR",      0,  "Keep the keypoints of the input images in this directory and reuse them while the file and the detector settings are unchanged. Default off.",0},
     { "threads",    't',    "number",   0,  "Number of threads to start for the matching task, default 1",0},
+    { "image-threads",'P',  "number",   0,  "Number of extra threads splitting the images of each frame among them, shared by all matching threads. Lowers the latency per frame with many images. Default 0 (off).",0},
     { "ff-threads", 'T',    "number",   0,  "Number of threads for video decoding, default auto",0},
+    { "keyframe-scan",'k',  "float",    0,  "Scan the keyframes first and fully decode only the GOPs around keyframes reaching this match percentage [0-100] for any image. Default off.",0 },
+    { "decoders",   'D',    "number",   0,  "Number of decoders working on GOP aligned segments of the file in parallel, default 1",0},
     { "queue",      'q',    "number",   0,  "Length of the frame queue between decoder and matcher threads. Default 5.",0 },
+    { "reorder-window",'w', "frames",   0,  "Number of frames whose matches are buffered for the in order output, decoding waits for frames beyond. Default 0 (twice the frames in flight). With --decoders the window grows to span the starts of that many consecutive ranges, so the decoders run in parallel. Not with --output, every buffered match holds a colour frame: the decoders then mostly wait for each other.",0 },
+    { "ring-queue", 'F',      NULL,    0,  "Pass the frames to the matching threads through a lock-free ring instead of the locked priority queue. Default false.",0 },
+    { "read-ahead", 'a',    "number",   0,  "Number of video packets a separate demuxer thread reads ahead of the decoder, 0 disables the thread. Default 64.",0 },
+    { "io-buffer",  'B',    "KiB",      0,  "Read regular files through a buffer of this size with kernel read-ahead hints, e.g. for network storage. Default 0 (libavformat IO).",0 },
     { NULL,         'i',    "FILE",     0,  "Input video file",0 },
     { "output",     'o',    "FILE.mpg", 0,  "Output a video with the keypoints drawn onto it. The keypoint matches for the first input image are colored in green.",0 },
     { 0 }
@@ -35,13 +58,33 @@ struct argp Arguments::argp = { Arguments::options, Arguments::argp_parse_opt, A
 Arguments::Arguments(){
     this->minFrame = 0;
     this->maxFrame = -1;
-    this->hessianThreshold = 300;
+    this->startTime = -1;
+    this->endTime = -1;
+    this->fastThreshold = 20;
+    this->featureCount = 500;
+    this->scaleLevels = 8;
+    this->detectorName = "orb";
+    this->benchmarkFrames = 0;
+    this->keypointMatchRadius = 5.0;
+    this->indexName = "kdtree";
+    this->votingMethod = "hough";
     this->argpState = NULL;
     this->matcherThreads = 1;
+    this->imageThreads = 0;
     this->decoderThreads = -1;
+    this->decoders = 1;
     this->queueSize = 5;
+    this->reorderWindow = 0;
+    this->readAhead = 64;
+    this->ioBufferSize = 0;
     this->outputFile = "";
+    this->cacheDir = "";
     this->scale = false;
+    this->hitMask = false;
+    this->seedTranslation = false;
+    this->ringQueue = false;
+    this->candidateRatio = -1.0;
+    this->keyframeThreshold = -1.0;
 }
 
 int Arguments::parseArgs( int argc, char **argv ){
@@ -62,26 +105,85 @@ void Arguments::setMinFrame( int frameNumber ){
 void Arguments::setDoScale(){
     this->scale = true;
 }
+void Arguments::setDoHitMask(){
+    this->hitMask = true;
+}
+void Arguments::setDoSeedTranslation(){
+    this->seedTranslation = true;
+}
+void Arguments::setDoRingQueue(){
+    this->ringQueue = true;
+}
 
 void Arguments::setMaxFrame( int frameNumber ){
     this->maxFrame = frameNumber;
 }
-void Arguments::setHessianThreshold( int thres ){
-    this->hessianThreshold = thres;
+void Arguments::setStartTime( long int ms ){
+    this->startTime = ms;
+}
+void Arguments::setEndTime( long int ms ){
+    this->endTime = ms;
+}
+
+void Arguments::framesFromTimes( double frameRate ){
+    // the time range overrides the frame range
+    if( this->startTime >= 0 ){
+        this->minFrame = (int) std::floor( this->startTime * frameRate / 1000.0 );
+    }
+    if( this->endTime >= 0 ){
+        this->maxFrame = (int) std::ceil( this->endTime * frameRate / 1000.0 );
+    }
+}
+
+void Arguments::setFastThreshold( int thres ){
+    this->fastThreshold = thres;
+}
+void Arguments::setFeatureCount( int count ){
+    this->featureCount = count;
+}
+void Arguments::setScaleLevels( int count ){
+    this->scaleLevels = count;
+}
+void Arguments::setDetectorName( std::string name ){
+    this->detectorName = name;
+}
+void Arguments::setBenchmarkFrames( int count ){
+    this->benchmarkFrames = count;
 }
 void Arguments::setKeypointMatchRadius( double r ){
     this->keypointMatchRadius = r;
 }
+void Arguments::setIndexName( std::string name ){
+    this->indexName = name;
+}
+void Arguments::setVotingMethod( std::string method ){
+    this->votingMethod = method;
+}
 
 void Arguments::setMatcherThreads( int count ){
     this->matcherThreads = count;
 }
+void Arguments::setImageThreads( int count ){
+    this->imageThreads = count;
+}
 void Arguments::setDecoderThreads( int count ){
     this->decoderThreads = count;
 }
+void Arguments::setDecoders( int count ){
+    this->decoders = count;
+}
 void Arguments::setQueueSize( int count ){
     this->queueSize = count;
 }
+void Arguments::setReorderWindow( int frames ){
+    this->reorderWindow = frames;
+}
+void Arguments::setReadAhead( int count ){
+    this->readAhead = count;
+}
+void Arguments::setIoBufferSize( int kib ){
+    this->ioBufferSize = kib;
+}
 
 void Arguments::addSearchFile( std::string fileName ){
     this->searchFiles.push_back( fileName );
@@ -95,12 +197,22 @@ void Arguments::setOutputFile( std::string fileName ){
     this->outputFile = fileName;
 }
 
+void Arguments::setCacheDir( std::string dir ){
+    this->cacheDir = dir;
+}
+
 void Arguments::addMatchRatio( double r ){
     this->matchRatios.push_back(r);
 }
 void Arguments::addSnrRatio( double r ){
     this->snrRatios.push_back(r);
 }
+void Arguments::setKeyframeThreshold( double r ){
+    this->keyframeThreshold = r;
+}
+void Arguments::setCandidateRatio( double r ){
+    this->candidateRatio = r;
+}
 
 
 
@@ -112,25 +224,80 @@ int Arguments::getMinFrame(){
 int Arguments::getMaxFrame(){
     return this->maxFrame;
 }
+long int Arguments::getStartTime(){
+    return this->startTime;
+}
+long int Arguments::getEndTime(){
+    return this->endTime;
+}
+bool Arguments::hasTimeRange(){
+    return this->startTime >= 0 || this->endTime >= 0;
+}
 bool Arguments::doScale(){
     return this->scale;
 }
-int Arguments::getHessianThreshold(){
-    return this->hessianThreshold;
+bool Arguments::doHitMask(){
+    return this->hitMask;
+}
+bool Arguments::doSeedTranslation(){
+    return this->seedTranslation;
+}
+bool Arguments::doRingQueue(){
+    return this->ringQueue;
+}
+int Arguments::getFastThreshold(){
+    return this->fastThreshold;
+}
+int Arguments::getFeatureCount(){
+    return this->featureCount;
+}
+int Arguments::getScaleLevels(){
+    return this->scaleLevels;
+}
+std::string Arguments::getDetectorName(){
+    return this->detectorName;
+}
+int Arguments::getBenchmarkFrames(){
+    return this->benchmarkFrames;
 }
 double Arguments::getKeypointMatchRadius(){
     return this->keypointMatchRadius;
 }
+std::string Arguments::getIndexName(){
+    return this->indexName;
+}
+std::string Arguments::getVotingMethod(){
+    return this->votingMethod;
+}
 
 int Arguments::getMatcherThreads(){
     return this->matcherThreads;
 }
+int Arguments::getImageThreads(){
+    return this->imageThreads;
+}
 int Arguments::getDecoderThreads(){
     return this->decoderThreads;
 }
+int Arguments::getDecoders(){
+    return this->decoders;
+}
 int Arguments::getQueueSize(){
     return this->queueSize;
 }
+int Arguments::getReorderWindow(){
+    if( this->reorderWindow > 0 ){
+        return this->reorderWindow;
+    }
+    // queued frames plus one per matcher and decoder are in flight
+    return 2 * ( this->queueSize + this->matcherThreads + this->decoders );
+}
+int Arguments::getReadAhead(){
+    return this->readAhead;
+}
+int Arguments::getIoBufferSize(){
+    return this->ioBufferSize;
+}
 
 std::vector<std::string> Arguments::getSearchFiles(){
     return this->searchFiles;
@@ -144,12 +311,28 @@ std::string Arguments::getOutputFile(){
     return this->outputFile;
 }
 
+std::string Arguments::getCacheDir(){
+    return this->cacheDir;
+}
+
 std::vector<double> Arguments::getMatchRatios(){
     return this->matchRatios;
 }
 std::vector<double> Arguments::getSnrRatios(){
     return this->snrRatios;
 }
+bool Arguments::doKeyframeScan(){
+    return this->keyframeThreshold >= 0.0;
+}
+double Arguments::getKeyframeThreshold(){
+    return this->keyframeThreshold;
+}
+bool Arguments::doCandidateFilter(){
+    return this->candidateRatio >= 0.0;
+}
+double Arguments::getCandidateRatio(){
+    return this->candidateRatio;
+}
 
 
 /* Parsing */
@@ -213,6 +396,15 @@ error_t Arguments::argp_parse_opt (int key, char *arg, struct argp_state *state)
     case 'S': ;
         self->setDoScale();
         return 0;
+    case 'K': ;
+        self->setDoHitMask();
+        return 0;
+    case 'F': ;
+        self->setDoRingQueue();
+        return 0;
+    case 'C': ;
+        self->setDoSeedTranslation();
+        return 0;
     }
 
     // args with a value
@@ -229,33 +421,96 @@ error_t Arguments::argp_parse_opt (int key, char *arg, struct argp_state *state)
     case 'M': ;
         self->setMaxFrame( self->parseIntNumber( argstr ) );
         break;
+    case 'b': ;
+        self->setStartTime( self->parseIntNumber( argstr ) );
+        break;
+    case 'e': ;
+        self->setEndTime( self->parseIntNumber( argstr ) );
+        break;
     case 'H': ;
-        self->setHessianThreshold( self->parseIntNumber( argstr ) );
+        self->setFastThreshold( self->parseIntNumber( argstr ) );
+        break;
+    case 'd': ;
+        if( ! KeyPointDetector::isValidName( argstr ) ){
+            self->exitErrorHelp( "Unknown detector" );
+        }
+        self->setDetectorName( argstr );
+        break;
+    case 'X': ;
+        self->setBenchmarkFrames( self->parseIntNumber( argstr ) );
+        break;
+    case 'n': ;
+        self->setFeatureCount( self->parseIntNumber( argstr ) );
+        break;
+    case 'l': ;
+        self->setScaleLevels( self->parseIntNumber( argstr ) );
+        if( self->getScaleLevels() < 1 ){
+            self->exitErrorHelp( "At least one pyramid level is required" );
+        }
         break;
     case 'R': ;
         self->setKeypointMatchRadius( self->parseDoubleNumber( argstr ) );
         break;
+    case 'I': ;
+        if( ! SpatialIndex::isValidName( argstr ) ){
+            self->exitErrorHelp( "Unknown index" );
+        }
+        self->setIndexName( argstr );
+        break;
+    case 'V': ;
+        if( ! TranslationVoter::isValidMethod( argstr ) ){
+            self->exitErrorHelp( "Unknown voting method" );
+        }
+        self->setVotingMethod( argstr );
+        break;
     case 't': ;
         self->setMatcherThreads( self->parseIntNumber( argstr ) );
         break;
+    case 'P': ;
+        self->setImageThreads( self->parseIntNumber( argstr ) );
+        break;
     case 'T': ;
         self->setDecoderThreads( self->parseIntNumber( argstr ) );
         break;
+    case 'D': ;
+        self->setDecoders( self->parseIntNumber( argstr ) );
+        if( self->getDecoders() < 1 ){
+            self->exitErrorHelp( "At least one decoder is required" );
+        }
+        break;
     case 'q': ;
         self->setQueueSize( self->parseIntNumber( argstr ) );
         break;
+    case 'w': ;
+        self->setReorderWindow( self->parseIntNumber( argstr ) );
+        break;
+    case 'a': ;
+        self->setReadAhead( self->parseIntNumber( argstr ) );
+        break;
+    case 'B': ;
+        self->setIoBufferSize( self->parseIntNumber( argstr ) );
+        break;
     case 'r': ;
         self->addMatchRatio( self->parsePercentToRatio( argstr ) );
         break;
     case 's': ;
         self->addSnrRatio( self->parseDoubleNumber( argstr ) );
         break;
+    case 'k': ;
+        self->setKeyframeThreshold( self->parsePercentToRatio( argstr ) );
+        break;
+    case 'c': ;
+        self->setCandidateRatio( self->parsePercentToRatio( argstr ) );
+        break;
     case 'i': ;
         self->setInputFile( argstr );
         break;
     case 'o': ;
         self->setOutputFile( argstr );
         break;
+    case 'A': ;
+        self->setCacheDir( argstr );
+        break;
     case ARGP_KEY_ARG:
         self->addSearchFile( argstr );
         break;
@@ -276,16 +531,43 @@ error_t Arguments::argp_parse_opt (int key, char *arg, struct argp_state *state)
 void Arguments::printArguments(){
     std::printf( "minFrame: %d\n", this->getMinFrame() );
     std::printf( "maxFrame: %d\n", this->getMaxFrame() );
+    if( this->hasTimeRange() ){
+        std::printf( "startTime: %ld\n", this->getStartTime() );
+        std::printf( "endTime: %ld\n", this->getEndTime() );
+    }
     std::printf( "scale: %d\n", this->doScale() );
     std::printf( "matcherThreads: %d\n", this->getMatcherThreads() );
+    std::printf( "imageThreads: %d\n", this->getImageThreads() );
     std::printf( "decoderThreads: %d\n", this->getDecoderThreads() );
+    std::printf( "decoders: %d\n", this->getDecoders() );
     std::printf( "queueSize: %d\n", this->getQueueSize() );
+    std::printf( "reorderWindow: %d\n", this->getReorderWindow() );
+    std::printf( "ringQueue: %d\n", this->doRingQueue() );
+    std::printf( "readAhead: %d\n", this->getReadAhead() );
+    std::printf( "ioBufferSize: %d KiB\n", this->getIoBufferSize() );
+    std::printf( "detector: %s\n", this->getDetectorName().c_str() );
+    std::printf( "fastThreshold: %d\n", this->getFastThreshold() );
+    std::printf( "featureCount: %d\n", this->getFeatureCount() );
+    std::printf( "scaleLevels: %d\n", this->getScaleLevels() );
     std::printf( "keypointMatchRadius: %f\n", this->getKeypointMatchRadius() );
+    std::printf( "index: %s\n", this->getIndexName().c_str() );
+    std::printf( "hitMask: %d\n", this->doHitMask() );
+    std::printf( "voting: %s\n", this->getVotingMethod().c_str() );
+    std::printf( "seedTranslation: %d\n", this->doSeedTranslation() );
+    if( this->doKeyframeScan() ){
+        std::printf( "keyframeThreshold: %f\n", this->getKeyframeThreshold() );
+    }
+    if( this->doCandidateFilter() ){
+        std::printf( "candidateRatio: %f\n", this->getCandidateRatio() );
+    }
 
     std::printf( "inputFile: %s\n", this->getInputFile().c_str() );
     if( this->getOutputFile() != "" ){
         std::printf( "outputFile: %s\n", this->getOutputFile().c_str() );
     }
+    if( this->getCacheDir() != "" ){
+        std::printf( "cacheDir: %s\n", this->getCacheDir().c_str() );
+    }
 
     for ( auto &sFile : this->getSearchFiles() ) {
         std::printf( "searchFile: %s\n", sFile.c_str() );
@@ -12,31 +12,73 @@ public:
 
     void setMinFrame( int frameNumber );
     void setMaxFrame( int frameNumber );
+    void setStartTime( long int ms );
+    void setEndTime( long int ms );
+    void framesFromTimes( double frameRate );
     void setDoScale();
-    void setHessianThreshold( int thres );
+    void setDoHitMask();
+    void setDoSeedTranslation();
+    void setDoRingQueue();
+    void setFastThreshold( int thres );
+    void setFeatureCount( int count );
+    void setScaleLevels( int count );
+    void setDetectorName( std::string name );
+    void setBenchmarkFrames( int count );
     void setKeypointMatchRadius( double r );
+    void setIndexName( std::string name );
+    void setVotingMethod( std::string method );
     void setMatcherThreads( int count );
+    void setImageThreads( int count );
     void setDecoderThreads( int count );
+    void setDecoders( int count );
     void setQueueSize( int count );
+    void setReorderWindow( int frames );
+    void setReadAhead( int count );
+    void setIoBufferSize( int kib );
     void setInputFile( std::string fileName );
     void setOutputFile( std::string fileName );
+    void setCacheDir( std::string dir );
     void addSearchFile( std::string fileName );
     void addMatchRatio( double r );
     void addSnrRatio( double r );
+    void setKeyframeThreshold( double r );
+    void setCandidateRatio( double r );
 
     int getMinFrame();
     int getMaxFrame();
+    long int getStartTime();
+    long int getEndTime();
+    bool hasTimeRange();
     bool doScale();
-    int getHessianThreshold();
+    bool doHitMask();
+    bool doSeedTranslation();
+    bool doRingQueue();
+    int getFastThreshold();
+    int getFeatureCount();
+    int getScaleLevels();
+    std::string getDetectorName();
+    int getBenchmarkFrames();
     double getKeypointMatchRadius();
+    std::string getIndexName();
+    std::string getVotingMethod();
     int getMatcherThreads();
+    int getImageThreads();
     int getDecoderThreads();
+    int getDecoders();
     int getQueueSize();
+    int getReorderWindow();
+    int getReadAhead();
+    int getIoBufferSize();
     std::string getInputFile();
     std::string getOutputFile();
+    std::string getCacheDir();
     std::vector<std::string> getSearchFiles();
     std::vector<double> getMatchRatios();
     std::vector<double> getSnrRatios();
+    bool doKeyframeScan();
+    double getKeyframeThreshold();
+    bool doCandidateFilter();
+    double getCandidateRatio();
 
     int parseArgs( int argc, char **argv );
     void setArgpState( struct argp_state *state);
@@ -59,17 +101,36 @@ private:
     /* config options*/
     int minFrame;
     int maxFrame;
-    int hessianThreshold;
+    long int startTime; // ms
+    long int endTime; // ms
+    int fastThreshold;
+    int featureCount;
+    int scaleLevels;
+    std::string detectorName;
+    int benchmarkFrames;
     double keypointMatchRadius;
+    std::string indexName;
+    std::string votingMethod;
     int matcherThreads;
+    int imageThreads;
     int decoderThreads;
+    int decoders;
     int queueSize;
+    int reorderWindow;
+    int readAhead;
+    int ioBufferSize; // KiB
     bool scale;
+    bool hitMask;
+    bool seedTranslation;
+    bool ringQueue;
     std::vector<std::string> searchFiles;
     std::string inputFile;
     std::string outputFile;
+    std::string cacheDir;
     std::vector<double> matchRatios;
     std::vector<double> snrRatios;
+    double keyframeThreshold;
+    double candidateRatio;
 };
 
 #endif // ARGUMENTS_H
@@ -0,0 +1,126 @@
+#include <string>
+#include <stdexcept>
+
+#if defined(__GNUC__) && ( defined(__x86_64__) || defined(__i386__) )
+#define DISTANCE_KERNELS_X86
+#include <immintrin.h>
+#endif
+
+#include "DistanceKernels.h"
+
+typedef int (*CountWithinFunc)( const float*, const float*, int, float, float, float );
+
+static CountWithinFunc selectCountWithin(){
+    if( DistanceKernels::hasAvx2() ){
+        return DistanceKernels::countWithinAvx2;
+    }
+    if( DistanceKernels::hasSse2() ){
+        return DistanceKernels::countWithinSse2;
+    }
+    return DistanceKernels::countWithinScalar;
+}
+
+int DistanceKernels::countWithin( const float* xs, const float* ys, int n, 
+        float cx, float cy, float squaredRadius ){
+    // resolved on first use, thread safe static initialization
+    static const CountWithinFunc func = selectCountWithin();
+    return func( xs, ys, n, cx, cy, squaredRadius );
+}
+
+std::string DistanceKernels::getIsa(){
+    if( DistanceKernels::hasAvx2() ){
+        return "avx2";
+    }
+    if( DistanceKernels::hasSse2() ){
+        return "sse2";
+    }
+    return "scalar";
+}
+
+bool DistanceKernels::hasSse2(){
+#ifdef DISTANCE_KERNELS_X86
+    return __builtin_cpu_supports( "sse2" );
+#else
+    return false;
+#endif
+}
+
+bool DistanceKernels::hasAvx2(){
+#ifdef DISTANCE_KERNELS_X86
+    return __builtin_cpu_supports( "avx2" );
+#else
+    return false;
+#endif
+}
+
+/*
+
+    Kernels. All of them compute the same single precision sums without fused
+    multiply-add, so they agree on every input.
+
+ */
+
+int DistanceKernels::countWithinScalar( const float* xs, const float* ys, int n, 
+        float cx, float cy, float squaredRadius ){
+    int count = 0;
+    for( int i=0; i<n; i++ ){
+        float dx = xs[i] - cx;
+        float dy = ys[i] - cy;
+        float dxx = dx*dx;
+        float dyy = dy*dy;
+        if( dxx + dyy < squaredRadius ){
+            count++;
+        }
+    }
+    return count;
+}
+
+#ifdef DISTANCE_KERNELS_X86
+
+__attribute__((target("sse2")))
+int DistanceKernels::countWithinSse2( const float* xs, const float* ys, int n, 
+        float cx, float cy, float squaredRadius ){
+    __m128 vcx = _mm_set1_ps( cx );
+    __m128 vcy = _mm_set1_ps( cy );
+    __m128 vr2 = _mm_set1_ps( squaredRadius );
+    int count = 0;
+    int i = 0;
+    for( ; i+4 <= n; i+=4 ){
+        __m128 dx = _mm_sub_ps( _mm_loadu_ps( xs+i ), vcx );
+        __m128 dy = _mm_sub_ps( _mm_loadu_ps( ys+i ), vcy );
+        __m128 d = _mm_add_ps( _mm_mul_ps( dx, dx ), _mm_mul_ps( dy, dy ) );
+        count += __builtin_popcount( _mm_movemask_ps( _mm_cmplt_ps( d, vr2 ) ) );
+    }
+    return count + DistanceKernels::countWithinScalar( xs+i, ys+i, n-i, cx, cy, squaredRadius );
+}
+
+__attribute__((target("avx2")))
+int DistanceKernels::countWithinAvx2( const float* xs, const float* ys, int n, 
+        float cx, float cy, float squaredRadius ){
+    __m256 vcx = _mm256_set1_ps( cx );
+    __m256 vcy = _mm256_set1_ps( cy );
+    __m256 vr2 = _mm256_set1_ps( squaredRadius );
+    int count = 0;
+    int i = 0;
+    for( ; i+8 <= n; i+=8 ){
+        __m256 dx = _mm256_sub_ps( _mm256_loadu_ps( xs+i ), vcx );
+        __m256 dy = _mm256_sub_ps( _mm256_loadu_ps( ys+i ), vcy );
+        __m256 d = _mm256_add_ps( _mm256_mul_ps( dx, dx ), _mm256_mul_ps( dy, dy ) );
+        count += __builtin_popcount( _mm256_movemask_ps( _mm256_cmp_ps( d, vr2, _CMP_LT_OQ ) ) );
+    }
+    return count + DistanceKernels::countWithinScalar( xs+i, ys+i, n-i, cx, cy, squaredRadius );
+}
+
+#else
+
+int DistanceKernels::countWithinSse2( const float* xs, const float* ys, int n, 
+        float cx, float cy, float squaredRadius ){
+    throw std::runtime_error("sse2 kernels are not available on this platform");
+}
+
+int DistanceKernels::countWithinAvx2( const float* xs, const float* ys, int n, 
+        float cx, float cy, float squaredRadius ){
+    throw std::runtime_error("avx2 kernels are not available on this platform");
+}
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef DISTANCE_KERNELS_H
+#define DISTANCE_KERNELS_H
+
+#include <string>
+
+/*
+ * Counts the points of a coordinate array closer than a radius to a center,
+ * the inner loop of the translation voting and hit counting.
+ * The widest instruction set the cpu supports is picked once at runtime.
+ */
+class DistanceKernels{
+
+public:
+    // (xs[i]-cx)^2 + (ys[i]-cy)^2 < squaredRadius for i in [0,n)
+    static int countWithin( const float* xs, const float* ys, int n, 
+            float cx, float cy, float squaredRadius );
+
+    static std::string getIsa();
+    static bool hasSse2();
+    static bool hasAvx2();
+
+    // the individual kernels, for tests and benchmarks
+    static int countWithinScalar( const float* xs, const float* ys, int n, 
+            float cx, float cy, float squaredRadius );
+    static int countWithinSse2( const float* xs, const float* ys, int n, 
+            float cx, float cy, float squaredRadius );
+    static int countWithinAvx2( const float* xs, const float* ys, int n, 
+            float cx, float cy, float squaredRadius );
+};
+
+#endif // DISTANCE_KERNELS_H
@@ -0,0 +1,101 @@
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+#include "FrameResult.h"
+#include "Match.h"
+
+
+FrameResult::FrameResult( int imageCount ){
+    this->frameTimestamp = 0.0;
+    this->frameIndex = 0;
+    this->keypointCount = 0;
+    this->images.assign( imageCount, { 0, 0, false } );
+}
+
+
+/* Setters */
+
+void FrameResult::setOutputMat( cv::Mat mat ){
+    this->outputMat = mat;
+}
+void FrameResult::setFrameTimestamp( double ts ){
+    this->frameTimestamp = ts;
+}
+void FrameResult::setFrameIndex( long int idx ){
+    this->frameIndex = idx;
+}
+void FrameResult::setKeypointCount( int nkp ){
+    this->keypointCount = nkp;
+}
+void FrameResult::setImageKeypointCount( int imageIndex, int nkp ){
+    this->images[imageIndex].imageKeypointCount = nkp;
+}
+void FrameResult::setKeypointMatchCount( int imageIndex, int nkpm ){
+    this->images[imageIndex].keypointMatchCount = nkpm;
+}
+void FrameResult::setSkipped( int imageIndex ){
+    this->images[imageIndex].skipped = true;
+}
+void FrameResult::enableMatchedFlags(){
+    this->matchedFlags.assign( this->keypointCount, 0 );
+}
+void FrameResult::setMatched( int keypointIndex ){
+    this->matchedFlags[keypointIndex] = 1;
+}
+
+
+/* Getters */
+
+cv::Mat FrameResult::getOutputMat(){
+    return this->outputMat;
+}
+double FrameResult::getFrameTimestamp(){
+    return this->frameTimestamp;
+}
+long int FrameResult::getFrameIndex(){
+    return this->frameIndex;
+}
+int FrameResult::getKeypointCount(){
+    return this->keypointCount;
+}
+int FrameResult::getImageCount(){
+    return this->images.size();
+}
+int FrameResult::getImageKeypointCount( int imageIndex ){
+    return this->images[imageIndex].imageKeypointCount;
+}
+int FrameResult::getKeypointMatchCount( int imageIndex ){
+    return this->images[imageIndex].keypointMatchCount;
+}
+bool FrameResult::isSkipped( int imageIndex ){
+    return this->images[imageIndex].skipped;
+}
+bool FrameResult::hasMatchedFlags(){
+    return ! this->matchedFlags.empty();
+}
+std::vector<unsigned char>& FrameResult::getMatchedFlags(){
+    return this->matchedFlags;
+}
+
+double FrameResult::getMatchRatio( int imageIndex ){
+    ImageHits& hits = this->images[imageIndex];
+    if( hits.imageKeypointCount == 0 ){
+        return 0.0;
+    }
+    return (hits.keypointMatchCount*1.0)/ hits.imageKeypointCount;
+}
+
+Match FrameResult::getMatch( int imageIndex ){
+    ImageHits& hits = this->images[imageIndex];
+    Match match;
+    match.setImageIndex( imageIndex );
+    match.setFrameIndex( this->frameIndex );
+    match.setFrameTimestamp( this->frameTimestamp );
+    match.setKeypointCount( this->keypointCount );
+    match.setImageKeypointCount( hits.imageKeypointCount );
+    match.setKeypointMatchCount( hits.keypointMatchCount );
+    if( hits.skipped ){
+        match.setSkipped();
+    }
+    return match;
+}
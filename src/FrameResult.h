@@ -0,0 +1,60 @@
+#ifndef FRAME_RESULT_H
+#define FRAME_RESULT_H
+
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+#include "Match.h"
+
+/*
+ * Matching result of one frame against all images, one record per frame in
+ * the queue. The per image counts are kept in one array, getMatch() expands
+ * an entry into the Match of that image.
+ */
+class FrameResult{
+
+public:
+    FrameResult( int imageCount );
+
+    void setOutputMat( cv::Mat mat );
+    void setFrameTimestamp( double ts );
+    void setFrameIndex( long int idx );
+    void setKeypointCount( int nkp );
+    void setImageKeypointCount( int imageIndex, int nkp );
+    void setKeypointMatchCount( int imageIndex, int nkpm );
+    void setSkipped( int imageIndex );
+    // one flag per frame keypoint, kept for the first image only (the one plotted 
+    // into the output video). Call after setKeypointCount().
+    void enableMatchedFlags();
+    void setMatched( int keypointIndex );
+
+    cv::Mat getOutputMat();
+    double getFrameTimestamp();
+    long int getFrameIndex();
+    int getKeypointCount();
+    int getImageCount();
+    int getImageKeypointCount( int imageIndex );
+    int getKeypointMatchCount( int imageIndex );
+    bool isSkipped( int imageIndex );
+    bool hasMatchedFlags();
+    std::vector<unsigned char>& getMatchedFlags();
+
+    double getMatchRatio( int imageIndex );
+    Match getMatch( int imageIndex );
+
+private:
+    struct ImageHits{
+        int keypointMatchCount;
+        int imageKeypointCount;
+        bool skipped; // placeholder for an image already found, not matched
+    };
+
+    cv::Mat outputMat;
+    double frameTimestamp;
+    long int frameIndex;
+    int keypointCount;
+    std::vector<ImageHits> images;
+    std::vector<unsigned char> matchedFlags; // empty unless enabled
+};
+
+#endif // FRAME_RESULT_H
@@ -0,0 +1,80 @@
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <algorithm>
+
+#include "FrameRing.h"
+#include "VideoFrame.h"
+
+
+FrameRing::FrameRing( std::size_t capacity ){
+    this->capacity = std::max( capacity, (std::size_t) 1 );
+    this->slots = std::make_unique<Slot[]>( this->capacity );
+    for( std::size_t i=0; i < this->capacity; i++ ){
+        this->slots[i].sequence = i;
+    }
+    this->enqueuePos = 0;
+    this->dequeuePos = 0;
+}
+
+bool FrameRing::push( std::shared_ptr<VideoFrame>& frame ){
+    std::size_t pos = this->enqueuePos.load( std::memory_order_relaxed );
+    Slot* slot;
+    while( true ){
+        slot = &this->slots[ pos % this->capacity ];
+        std::size_t seq = slot->sequence.load( std::memory_order_acquire );
+        intptr_t diff = (intptr_t) seq - (intptr_t) pos;
+        if( diff == 0 ){
+            // the slot is free for this position, claim it
+            if( this->enqueuePos.compare_exchange_weak( pos, pos+1 ) ){
+                break;
+            }
+        }else if( diff < 0 ){
+            // the slot still holds the frame of the last round
+            return false;
+        }else{
+            // another producer took the position
+            pos = this->enqueuePos.load( std::memory_order_relaxed );
+        }
+    }
+    slot->frame = frame;
+    slot->sequence.store( pos+1, std::memory_order_release );
+    return true;
+}
+
+bool FrameRing::pop( std::shared_ptr<VideoFrame>& frame ){
+    std::size_t pos = this->dequeuePos.load( std::memory_order_relaxed );
+    Slot* slot;
+    while( true ){
+        slot = &this->slots[ pos % this->capacity ];
+        std::size_t seq = slot->sequence.load( std::memory_order_acquire );
+        intptr_t diff = (intptr_t) seq - (intptr_t) (pos+1);
+        if( diff == 0 ){
+            if( this->dequeuePos.compare_exchange_weak( pos, pos+1 ) ){
+                break;
+            }
+        }else if( diff < 0 ){
+            // not pushed yet
+            return false;
+        }else{
+            pos = this->dequeuePos.load( std::memory_order_relaxed );
+        }
+    }
+    frame = std::move( slot->frame );
+    slot->frame = nullptr;
+    // free the slot for the push one round later
+    slot->sequence.store( pos + this->capacity, std::memory_order_release );
+    return true;
+}
+
+bool FrameRing::empty(){
+    // the dequeue position first, it never passes the enqueue position
+    std::size_t dequeued = this->dequeuePos.load();
+    return this->enqueuePos.load() == dequeued;
+}
+
+bool FrameRing::full(){
+    std::size_t dequeued = this->dequeuePos.load();
+    return this->enqueuePos.load() - dequeued >= this->capacity;
+}
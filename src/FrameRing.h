@@ -0,0 +1,39 @@
+#ifndef FRAME_RING_H
+#define FRAME_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+#include "VideoFrame.h"
+
+/*
+ * Bounded lock-free multi producer multi consumer ring of frames. Every slot
+ * carries a sequence number telling whether it is free for the push at that
+ * position or holds the frame for the pop at that position.
+ */
+class FrameRing{
+
+public:
+    FrameRing( std::size_t capacity );
+
+    // false when full or empty, never blocks
+    bool push( std::shared_ptr<VideoFrame>& frame );
+    bool pop( std::shared_ptr<VideoFrame>& frame );
+    bool empty();
+    bool full();
+
+private:
+    struct Slot{
+        std::atomic<std::size_t> sequence;
+        std::shared_ptr<VideoFrame> frame;
+    };
+
+    std::size_t capacity;
+    std::unique_ptr<Slot[]> slots;
+    // kept on their own cache lines, producers and consumers update them
+    alignas(64) std::atomic<std::size_t> enqueuePos;
+    alignas(64) std::atomic<std::size_t> dequeuePos;
+};
+
+#endif // FRAME_RING_H
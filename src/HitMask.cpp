@@ -0,0 +1,75 @@
+#include <cstdint>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <opencv2/opencv.hpp>
+
+#include "HitMask.h"
+
+
+HitMask::HitMask( std::vector<cv::KeyPoint>& keypoints, double radius ){
+    this->radius = radius;
+    this->originX = 0;
+    this->originY = 0;
+    this->width = 0;
+    this->height = 0;
+    this->stride = 0;
+    if( keypoints.size() == 0 || !( radius > 0.0 ) ){
+        return;
+    }
+
+    // bounding box of the keypoints grown by the radius
+    float minX = keypoints[0].pt.x;
+    float minY = keypoints[0].pt.y;
+    float maxX = minX;
+    float maxY = minY;
+    for( auto& kp : keypoints ){
+        minX = std::min( minX, kp.pt.x );
+        minY = std::min( minY, kp.pt.y );
+        maxX = std::max( maxX, kp.pt.x );
+        maxY = std::max( maxY, kp.pt.y );
+    }
+    this->originX = (int) std::floor( minX - radius );
+    this->originY = (int) std::floor( minY - radius );
+    this->width = (int) std::ceil( maxX + radius ) - this->originX + 1;
+    this->height = (int) std::ceil( maxY + radius ) - this->originY + 1;
+    this->stride = (this->width + 63) / 64;
+    this->bits.assign( (std::size_t) this->stride * this->height, 0 );
+
+    // rasterize a disc per keypoint, with the same strict distance test as the index
+    float squaredRadius = radius*radius;
+    for( auto& kp : keypoints ){
+        int y0 = (int) std::floor( kp.pt.y - radius );
+        int y1 = (int) std::ceil( kp.pt.y + radius );
+        int x0 = (int) std::floor( kp.pt.x - radius );
+        int x1 = (int) std::ceil( kp.pt.x + radius );
+        for( int py = y0; py <= y1; py++ ){
+            float dy = kp.pt.y - py;
+            for( int px = x0; px <= x1; px++ ){
+                float dx = kp.pt.x - px;
+                if( dx*dx + dy*dy < squaredRadius ){
+                    this->set( px, py );
+                }
+            }
+        }
+    }
+}
+
+double HitMask::getRadius(){
+    return this->radius;
+}
+int HitMask::getWidth(){
+    return this->width;
+}
+int HitMask::getHeight(){
+    return this->height;
+}
+std::size_t HitMask::getByteSize(){
+    return this->bits.size() * sizeof(uint64_t);
+}
+
+void HitMask::set( int px, int py ){
+    px = px - this->originX;
+    py = py - this->originY;
+    this->bits[ py*this->stride + (px >> 6) ] |= (uint64_t) 1 << (px & 63);
+}
@@ -0,0 +1,46 @@
+#ifndef HIT_MASK_H
+#define HIT_MASK_H
+
+#include <cstdint>
+#include <vector>
+#include <cmath>
+#include <opencv2/opencv.hpp>
+
+/*
+ * One bit per pixel, set where an image keypoint lies closer than the radius.
+ * Covers the bounding box of the keypoints grown by the radius, queries are
+ * rounded to the nearest pixel.
+ */
+class HitMask{
+
+public:
+    HitMask( std::vector<cv::KeyPoint>& keypoints, double radius );
+
+    double getRadius();
+    int getWidth();
+    int getHeight();
+    std::size_t getByteSize();
+
+    // hot path of the matcher, kept in the header
+    bool test( float x, float y ){
+        int px = (int) std::lround( x ) - this->originX;
+        int py = (int) std::lround( y ) - this->originY;
+        if( (unsigned) px >= (unsigned) this->width || (unsigned) py >= (unsigned) this->height ){
+            return false;
+        }
+        return ( this->bits[ py*this->stride + (px >> 6) ] >> (px & 63) ) & 1;
+    }
+
+private:
+    void set( int px, int py );
+
+    double radius;
+    int originX;
+    int originY;
+    int width;
+    int height;
+    int stride; // 64 bit words per row
+    std::vector<uint64_t> bits;
+};
+
+#endif // HIT_MASK_H
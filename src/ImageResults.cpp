@@ -0,0 +1,103 @@
+#include <vector>
+#include <memory>
+#include <cstdio>
+
+#include "ImageResults.h"
+#include "InputImage.h"
+#include "Match.h"
+
+ImageResults::ImageResults(){
+    this->images = std::make_shared< std::vector<InputImage> >();
+}
+
+ImageResults::ImageResults( std::shared_ptr< std::vector<InputImage> > images ){
+    this->images = images;
+    this->results.resize( images->size() );
+    for( auto& r : this->results ){
+        r.totalFramesSeen = 0;
+        r.totalKeypointMiss = 0;
+        r.totalKeypointHit = 0;
+    }
+}
+
+
+/* Updates */
+
+void ImageResults::updateBestMatch( Match& match ){
+    Result& r = this->results.at( match.getImageIndex() );
+    if( match.getMatchRatio() > r.bestMatch.getMatchRatio() 
+            && match.getSnr() > r.bestMatch.getSnr() ){
+        r.bestMatch = match;
+    }
+}
+
+void ImageResults::updateMatchAverages( Match& match ){
+    Result& r = this->results.at( match.getImageIndex() );
+    long missCount = match.getKeypointCount() - match.getKeypointMatchCount();
+    r.totalFramesSeen++;
+    r.totalKeypointMiss = r.totalKeypointMiss + missCount;
+    r.totalKeypointHit = r.totalKeypointHit + match.getKeypointMatchCount();
+}
+
+
+/* Getters */
+
+Match ImageResults::getBestMatch( int imageIndex ){
+    return this->results.at( imageIndex ).bestMatch;
+}
+double ImageResults::getBestSnr( int imageIndex ){
+    return this->results.at( imageIndex ).bestMatch.getSnr();
+}
+double ImageResults::getBestMatchRatio( int imageIndex ){
+    int keypointCount = this->images->at( imageIndex ).getKeypointCount();
+    return (this->results.at( imageIndex ).bestMatch.getKeypointMatchCount()*1.0)/ keypointCount;
+}
+double ImageResults::getAverageKeypointMiss( int imageIndex ){
+    Result& r = this->results.at( imageIndex );
+    return (double) ( r.totalKeypointMiss / r.totalFramesSeen);
+}
+double ImageResults::getAverageKeypointHit( int imageIndex ){
+    Result& r = this->results.at( imageIndex );
+    return (double) ( r.totalKeypointHit / r.totalFramesSeen);
+}
+long ImageResults::getTotalKeypointMiss( int imageIndex ){
+    return this->results.at( imageIndex ).totalKeypointMiss;
+}
+long ImageResults::getTotalKeypointHit( int imageIndex ){
+    return this->results.at( imageIndex ).totalKeypointHit;
+}
+long ImageResults::getTotalFramesSeen( int imageIndex ){
+    return this->results.at( imageIndex ).totalFramesSeen;
+}
+
+bool ImageResults::isFound( int imageIndex ){
+    InputImage& img = this->images->at( imageIndex );
+    double r = this->getBestMatchRatio( imageIndex );
+    double snr = this->getBestSnr( imageIndex );
+    if( r >= img.getMinMatchRatio() && snr >= img.getMinSnr() ){
+        return true;
+    }
+    return false;
+}
+bool ImageResults::isFullMatch( Match& match ){
+    return this->images->at( match.getImageIndex() ).isFullMatch( match );
+}
+
+
+void ImageResults::dumpBestMatch(){
+    for( int i=0; i < this->results.size(); i++ ){
+        InputImage& img = this->images->at( i );
+        Result& r = this->results[i];
+        int keypointCount = img.getKeypointCount();
+        double matchPer = this->getBestMatchRatio( i )*100;
+        double snr = this->getBestSnr( i );
+        double avgSnr = (r.totalKeypointHit*2.0)/( r.totalKeypointMiss + keypointCount*r.totalFramesSeen );
+
+        std::printf( "Best match img%d: frame=%ld, ts=%f, hits=%.2f%% (%d/%d ~ %d/%d), snr=%.3f, avg_snr=%.3f, rel_snr=%.3f\n", 
+            img.getIndex(), r.bestMatch.getFrameIndex(), r.bestMatch.getFrameTimestamp(), matchPer,
+            r.bestMatch.getKeypointMatchCount(), keypointCount, 
+            r.bestMatch.getKeypointMatchCount(), r.bestMatch.getKeypointCount(), 
+            snr, avgSnr, snr - avgSnr
+        );
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef IMAGE_RESULTS_H
+#define IMAGE_RESULTS_H
+
+#include <vector>
+#include <memory>
+
+#include "InputImage.h"
+#include "Match.h"
+
+/*
+ * Best match and hit statistics of every image. Owned and updated by the
+ * encode worker alone, the matching threads only read the images.
+ */
+class ImageResults{
+
+public:
+    ImageResults();
+    ImageResults( std::shared_ptr< std::vector<InputImage> > images );
+
+    void updateBestMatch( Match& match );
+    void updateMatchAverages( Match& match );
+
+    Match getBestMatch( int imageIndex );
+    double getBestSnr( int imageIndex );
+    double getBestMatchRatio( int imageIndex );
+    double getAverageKeypointMiss( int imageIndex );
+    double getAverageKeypointHit( int imageIndex );
+    long getTotalKeypointMiss( int imageIndex );
+    long getTotalKeypointHit( int imageIndex );
+    long getTotalFramesSeen( int imageIndex );
+
+    bool isFound( int imageIndex );
+    bool isFullMatch( Match& match );
+
+    void dumpBestMatch();
+
+private:
+    struct Result{
+        Match bestMatch;
+        long totalFramesSeen;
+        long totalKeypointMiss;
+        long totalKeypointHit;
+    };
+
+    std::shared_ptr< std::vector<InputImage> > images;
+    std::vector<Result> results;
+};
+
+#endif // IMAGE_RESULTS_H
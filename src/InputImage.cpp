@@ -5,13 +5,10 @@
 
 #include "InputImage.h"
 #include "SurfMatcher.h"
-#include "KdTree.h"
+#include "SpatialIndex.h"
+#include "HitMask.h"
 
 InputImage::InputImage(){
-    //this->database = KdTree;
-    this->totalFramesSeen = 0;
-    this->totalKeypointMiss = 0;
-    this->totalKeypointHit = 0;
     this->minMatchRatio = 1.0;
     this->minSnr = std::numeric_limits<double>::infinity();
 }
@@ -20,7 +17,27 @@ InputImage::InputImage(){
 }*/
 
 cv::KeyPoint InputImage::getNearestKeyPoint( int x, int y ){
-    return this->database.nearestNeighborSearch( x, y );
+    return this->database->nearestNeighborSearch( x, y );
+}
+bool InputImage::hasNeighborWithin( float x, float y, double radius ){
+    if( this->hitMask != nullptr && this->hitMask->getRadius() == radius ){
+        return this->hitMask->test( x, y );
+    }
+    return this->database->hasNeighborWithin( x, y, radius );
+}
+int InputImage::countWithin( float x, float y, double radius ){
+    return this->database->countWithin( x, y, radius );
+}
+std::vector<cv::KeyPoint> InputImage::getKeyPoints(){
+    // in index order
+    std::vector<cv::KeyPoint> keypoints;
+    for( int i=0; i < this->database->size(); i++ ){
+        keypoints.push_back( this->database->getKeyPoint( i ) );
+    }
+    return keypoints;
+}
+std::shared_ptr<SpatialIndex> InputImage::getDatabase(){
+    return this->database;
 }
 
 
@@ -40,20 +57,19 @@ void InputImage::setKeypointCount( int num ){
     this->keypointCount = num;
 }
 void InputImage::setKeyPoints( std::vector<cv::KeyPoint>& keypoints ){
-    this->database = KdTree( keypoints );
+    this->setKeyPoints( keypoints, "kdtree", 0.0 );
+}
+void InputImage::setKeyPoints( std::vector<cv::KeyPoint>& keypoints, std::string indexName, double radius ){
+    this->database = SpatialIndex::create( indexName, keypoints, radius );
     this->setKeypointCount( keypoints.size() );
-    //this->database.dumpDOT();
 }
-void InputImage::setBestMatch( Match match ){
-    this->bestMatch = match;
+void InputImage::setDatabase( std::shared_ptr<SpatialIndex> db ){
+    this->database = db;
+    this->setKeypointCount( db->size() );
 }
-
-void InputImage::updateAverages( int hitCount, int missCount ){
-    this->totalFramesSeen++;
-    this->totalKeypointMiss = this->totalKeypointMiss + missCount;
-    this->totalKeypointHit = this->totalKeypointHit + hitCount;
+void InputImage::setHitMask( std::shared_ptr<HitMask> mask ){
+    this->hitMask = mask;
 }
-
 void InputImage::setMinMatchRatio( double r ){
     this->minMatchRatio = r;
 }
@@ -88,61 +104,11 @@ double InputImage::getMinSnr(){
     return this->minSnr;
 }
 
-Match InputImage::getBestMatch(){
-    return this->bestMatch;
-}
-double InputImage::getAverageKeypointMiss(){
-    return (double) ( this->totalKeypointMiss / this->totalFramesSeen);
-}
-double InputImage::getAverageKeypointHit(){
-    return (double) ( this->totalKeypointHit / this->totalFramesSeen);
-}
-long InputImage::getTotalKeypointMiss(){
-    return this->totalKeypointMiss;
-}
-long InputImage::getTotalKeypointHit(){
-    return this->totalKeypointHit;
-}
-long InputImage::getTotalFramesSeen(){
-    return this->totalFramesSeen;
-}
-
-double InputImage::getBestSnr(){
-    return this->bestMatch.getSnr();
-}
-double InputImage::getBestMatchRatio(){
-    return (this->bestMatch.getKeypointMatchCount()*1.0)/ this->keypointCount;
-}
-
-bool InputImage::isFound(){
-    double r = this->getBestMatchRatio();
-    double snr = this->getBestSnr();
+bool InputImage::isFullMatch( Match& match ){
+    double r = match.getMatchRatio();
+    double snr = match.getSnr();
     if( r >= this->minMatchRatio && snr >= this->minSnr ){
         return true;
     }
     return false;
 }
-bool InputImage::isFullMatch( std::shared_ptr<Match> match ){
-    double r = match->getMatchRatio();
-    double snr = match->getSnr();
-    if( r >= this->minMatchRatio && snr >= this->minSnr ){
-        return true;
-    }
-    return false;
-}
-
-
-void InputImage::dumpBestMatch(){
-    double matchPer = this->getBestMatchRatio()*100;
-    double snr = this->getBestSnr();
-    double avgSnr = (this->totalKeypointHit*2.0)/( this->totalKeypointMiss + this->keypointCount*this->totalFramesSeen );
-
-    std::printf( "Best match img%d: frame=%ld, ts=%f, hits=%.2f%% (%d/%d ~ %d/%d), snr=%.3f, avg_snr=%.3f, rel_snr=%.3f\n", 
-        this->index, this->bestMatch.getFrameIndex(), this->bestMatch.getFrameTimestamp(), matchPer,
-        this->bestMatch.getKeypointMatchCount(), this->keypointCount, 
-        this->bestMatch.getKeypointMatchCount(), this->bestMatch.getKeypointCount(), 
-        snr, avgSnr, snr - avgSnr
-    );
-}
-
-
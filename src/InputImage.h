@@ -5,16 +5,24 @@
 #include <opencv2/opencv.hpp>
 
 //#include "SurfMatcher.h"
-#include "KdTree.h"
+#include "SpatialIndex.h"
+#include "HitMask.h"
 #include "Match.h"
 
-class InputImage{
+/*
+ * Keypoints and match criteria of one image, read by all matching threads
+ * once prepared. The results live in ImageResults.
+ */
+class alignas(64) InputImage{
 
 public:
     InputImage();
     //~InputImage();
 
     cv::KeyPoint getNearestKeyPoint( int x, int y );
+    bool hasNeighborWithin( float x, float y, double radius );
+    int countWithin( float x, float y, double radius );
+    std::vector<cv::KeyPoint> getKeyPoints();
 
     int getWidth();
     int getHeight();
@@ -22,12 +30,6 @@ public:
     std::string getFileName();
     int getKeypointCount();
 
-    double getAverageKeypointMiss();
-    double getAverageKeypointHit();
-    long getTotalKeypointMiss();
-    long getTotalKeypointHit();
-    long getTotalFramesSeen();
-    Match getBestMatch();
     double getMinMatchRatio();
     double getMinSnr();
 
@@ -36,18 +38,14 @@ public:
     void setFileName( std::string fileName );
     void setKeypointCount( int num );
     void setKeyPoints( std::vector<cv::KeyPoint>& keypoints );
+    void setKeyPoints( std::vector<cv::KeyPoint>& keypoints, std::string indexName, double radius );
+    void setDatabase( std::shared_ptr<SpatialIndex> db );
+    std::shared_ptr<SpatialIndex> getDatabase();
+    void setHitMask( std::shared_ptr<HitMask> mask );
     void setMinMatchRatio( double r );
     void setMinSnr( double r );
 
-    void setBestMatch( Match match );
-    void updateAverages( int hitCount, int missCount );
-
-    double getBestSnr();
-    double getBestMatchRatio();
-    bool isFound();
-    bool isFullMatch( std::shared_ptr<Match> match );
-
-    void dumpBestMatch();
+    bool isFullMatch( Match& match );
 
 private:
     int width;
@@ -55,11 +53,10 @@ private:
     int index;
     std::string fileName;
     int keypointCount;
-    KdTree database;
-    Match bestMatch;
-    long totalFramesSeen;
-    long totalKeypointMiss;
-    long totalKeypointHit;
+    // immutable once built, copies of the image share it
+    std::shared_ptr<SpatialIndex> database;
+    // optional, answers hit queries of its radius
+    std::shared_ptr<HitMask> hitMask;
     
     double minMatchRatio;
     double minSnr;
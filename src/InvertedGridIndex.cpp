@@ -0,0 +1,163 @@
+#include <stdexcept>
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <cmath>
+
+#include "InvertedGridIndex.h"
+
+
+InvertedGridIndex::InvertedGridIndex( double cellSize ){
+    if( !( cellSize > 0.0 ) ){
+        cellSize = 1.0;
+    }
+    this->cellSize = cellSize;
+    this->invCellSize = 1.0 / cellSize;
+    this->originX = 0;
+    this->originY = 0;
+    this->columns = 0;
+    this->rows = 0;
+    this->imageCount = 0;
+}
+
+void InvertedGridIndex::addImage( int imageIndex, std::vector<cv::KeyPoint>& keypoints ){
+    for( auto& kp : keypoints ){
+        this->pendingImages.push_back( imageIndex );
+        this->pendingPoints.push_back( kp.pt );
+    }
+    this->imageCount = std::max( this->imageCount, imageIndex+1 );
+}
+
+void InvertedGridIndex::build(){
+    int n = this->pendingPoints.size();
+    this->cellStart.assign( 1, 0 );
+    this->images.clear();
+    this->xs.clear();
+    this->ys.clear();
+    this->columns = 0;
+    this->rows = 0;
+    if( n == 0 ){
+        return;
+    }
+
+    // bounding box of all keypoints
+    double minX = this->pendingPoints[0].x;
+    double minY = this->pendingPoints[0].y;
+    double maxX = minX;
+    double maxY = minY;
+    for( auto& pt : this->pendingPoints ){
+        minX = std::min( minX, (double) pt.x );
+        minY = std::min( minY, (double) pt.y );
+        maxX = std::max( maxX, (double) pt.x );
+        maxY = std::max( maxY, (double) pt.y );
+    }
+    this->originX = minX;
+    this->originY = minY;
+
+    long int cellLimit = std::max( (long int) n * InvertedGridIndex::maxCellsPerPoint, 
+        (long int) InvertedGridIndex::minCellLimit );
+    while( true ){
+        this->invCellSize = 1.0 / this->cellSize;
+        this->columns = (int) std::floor( (maxX - minX) * this->invCellSize ) + 1;
+        this->rows = (int) std::floor( (maxY - minY) * this->invCellSize ) + 1;
+        if( (long int) this->columns * this->rows <= cellLimit ){
+            break;
+        }
+        this->cellSize = this->cellSize * 2;
+    }
+
+    // counting sort of the postings into the cells
+    int cellCount = this->columns * this->rows;
+    std::vector<int> cellOf( n );
+    this->cellStart.assign( cellCount+1, 0 );
+    for( int i=0; i < n; i++ ){
+        int c = this->cellRow( this->pendingPoints[i].y ) * this->columns + this->cellColumn( this->pendingPoints[i].x );
+        cellOf[i] = c;
+        this->cellStart[c+1]++;
+    }
+    for( int c=0; c < cellCount; c++ ){
+        this->cellStart[c+1] += this->cellStart[c];
+    }
+    std::vector<int> fill( this->cellStart.begin(), this->cellStart.end()-1 );
+    this->images.resize( n );
+    this->xs.resize( n );
+    this->ys.resize( n );
+    for( int i=0; i < n; i++ ){
+        int pos = fill[ cellOf[i] ]++;
+        this->images[pos] = this->pendingImages[i];
+        this->xs[pos] = this->pendingPoints[i].x;
+        this->ys[pos] = this->pendingPoints[i].y;
+    }
+    this->pendingImages.clear();
+    this->pendingImages.shrink_to_fit();
+    this->pendingPoints.clear();
+    this->pendingPoints.shrink_to_fit();
+}
+
+void InvertedGridIndex::countHits( std::vector<cv::KeyPoint>& keypoints, double radius, 
+        std::vector<int>& hits, std::vector<int>& scratch ){
+    hits.assign( this->imageCount, 0 );
+    // last keypoint that hit an image, counts each keypoint once per image
+    scratch.assign( this->imageCount, -1 );
+    if( this->columns == 0 ){
+        return;
+    }
+    float squaredRadius = radius*radius;
+    double right = this->originX + this->columns * this->cellSize;
+    double bottom = this->originY + this->rows * this->cellSize;
+
+    const int* cellStart = this->cellStart.data();
+    const int* images = this->images.data();
+    const float* xs = this->xs.data();
+    const float* ys = this->ys.data();
+    for( int k=0; k < keypoints.size(); k++ ){
+        float x = keypoints[k].pt.x;
+        float y = keypoints[k].pt.y;
+        if( x + radius < this->originX || y + radius < this->originY 
+                || x - radius >= right || y - radius >= bottom ){
+            continue;
+        }
+        int col0 = this->cellColumn( x - radius );
+        int col1 = this->cellColumn( x + radius );
+        int row0 = this->cellRow( y - radius );
+        int row1 = this->cellRow( y + radius );
+        for( int row = row0; row <= row1; row++ ){
+            int begin = cellStart[ row * this->columns + col0 ];
+            int end = cellStart[ row * this->columns + col1 + 1 ];
+            for( int i = begin; i < end; i++ ){
+                float dx = xs[i] - x;
+                float dy = ys[i] - y;
+                if( dx*dx + dy*dy < squaredRadius && scratch[ images[i] ] != k ){
+                    scratch[ images[i] ] = k;
+                    hits[ images[i] ]++;
+                }
+            }
+        }
+    }
+}
+
+int InvertedGridIndex::getImageCount(){
+    return this->imageCount;
+}
+int InvertedGridIndex::size(){
+    return this->images.size();
+}
+int InvertedGridIndex::getColumns(){
+    return this->columns;
+}
+int InvertedGridIndex::getRows(){
+    return this->rows;
+}
+double InvertedGridIndex::getCellSize(){
+    return this->cellSize;
+}
+
+/* Grid Helpers */
+
+int InvertedGridIndex::cellColumn( double x ){
+    int col = (int) std::floor( (x - this->originX) * this->invCellSize );
+    return std::min( std::max( col, 0 ), this->columns-1 );
+}
+int InvertedGridIndex::cellRow( double y ){
+    int row = (int) std::floor( (y - this->originY) * this->invCellSize );
+    return std::min( std::max( row, 0 ), this->rows-1 );
+}
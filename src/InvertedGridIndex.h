@@ -0,0 +1,55 @@
+#ifndef INVERTED_GRID_INDEX_H
+#define INVERTED_GRID_INDEX_H
+
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+/*
+ * One uniform grid over the keypoints of all input images. Every cell holds a
+ * posting list of (image, keypoint position), packed cell by cell like KeyPointGrid.
+ * Counts the hits of a frame for all images in one pass over its keypoints.
+ */
+class InvertedGridIndex{
+
+public:
+    InvertedGridIndex( double cellSize );
+
+    void addImage( int imageIndex, std::vector<cv::KeyPoint>& keypoints );
+    void build();
+
+    // hits[i]: number of keypoints having a keypoint of image i closer than the radius
+    void countHits( std::vector<cv::KeyPoint>& keypoints, double radius, 
+            std::vector<int>& hits, std::vector<int>& scratch );
+
+    int getImageCount();
+    int size();
+    int getColumns();
+    int getRows();
+    double getCellSize();
+
+    // the cell size grows until there are at most this many cells per posting
+    static const int maxCellsPerPoint = 4;
+    static const int minCellLimit = 4096;
+
+private:
+    int cellColumn( double x );
+    int cellRow( double y );
+
+    double originX;
+    double originY;
+    double cellSize;
+    double invCellSize;
+    int columns;
+    int rows;
+    int imageCount;
+    std::vector<int> cellStart;
+    // postings in cell order
+    std::vector<int> images;
+    std::vector<float> xs;
+    std::vector<float> ys;
+    // postings as added, until build()
+    std::vector<int> pendingImages;
+    std::vector<cv::Point2f> pendingPoints;
+};
+
+#endif // INVERTED_GRID_INDEX_H
@@ -1,162 +1,126 @@
 #include <stdexcept>
 #include <opencv2/opencv.hpp>
 #include <algorithm>
-#include <stdexcept>
 #include <cstdio>
-#include <cmath>
 #include <limits>
-#include <memory>
 
 #include "KdTree.h"
 
 
-/* Node Constructors */
+/* Tree Constructors */
 
-KdTreeNode::KdTreeNode(){
-    // constructor for empty nodes
-    this->isEmpty = true;
-    this->isLeaf = true;
-    this->x = 0;
-    this->y = 0;
-    this->leftChild = nullptr;
-    this->rightChild = nullptr;
-}
-KdTreeNode::KdTreeNode( int x, int y, KdTreeNode& left, KdTreeNode& right ){
-    // not really used
-    this->isEmpty = false;
-    this->isLeaf = false;
-    this->x = x;
-    this->y = y;
-    this->leftChild = std::shared_ptr<KdTreeNode>( new KdTreeNode(left) );
-    this->rightChild = std::shared_ptr<KdTreeNode>( new KdTreeNode(right) );
-}
-KdTreeNode::KdTreeNode( cv::KeyPoint& keypoint, KdTreeNode& left, KdTreeNode& right ){
-    // constructor for regular nodes
-    this->isEmpty = false;
-    this->isLeaf = false;
-    this->keypoint = keypoint;
-    this->x = (int) keypoint.pt.x;
-    this->y = (int) keypoint.pt.y;
-    this->leftChild = std::shared_ptr<KdTreeNode>( new KdTreeNode(left) );
-    this->rightChild = std::shared_ptr<KdTreeNode>( new KdTreeNode(right) );
+KdTree::KdTree(){
 }
-KdTreeNode::KdTreeNode( cv::KeyPoint& keypoint ){
-    // constructor for leaf node
-    this->isEmpty = false;
-    this->isLeaf = true;
-    this->keypoint = keypoint;
-    this->x = (int) keypoint.pt.x;
-    this->y = (int) keypoint.pt.y;
+KdTree::KdTree( std::vector<cv::KeyPoint>& keypoints) : KdTree( keypoints, false ){
 }
-
-/* Node Methods */
-
-bool KdTreeNode::empty(){ 
-    return this->isEmpty; 
-};
-bool KdTreeNode::leaf(){ 
-    return this->isLeaf; 
-};
-
-int KdTreeNode::autoID( int previous ){
-    int next = previous+1; 
-    this->setID( next );
-    if( ! this->leaf() ){
-        next = this->leftChild->autoID( next );
-        next = this->rightChild->autoID( next );
+KdTree::KdTree( std::vector<cv::KeyPoint>& keypoints, bool treeOrder ){
+    if( keypoints.size() == 0 ){
+        throw std::runtime_error("root node is empty");
+    }
+    this->keypoints = keypoints;
+    if( ! treeOrder ){
+        this->build( 0, this->keypoints.size(), 0 );
     }
-    return next;
-}
 
-void KdTreeNode::dumpDOT( ){
-    if( ! this->leaf() ){
-        std::printf( "\t\"%d-(%d,%d)\" -> \"%d-(%d,%d)\" [color=blue];\n",
-            this->ID, this->x, this->y,
-            this->leftChild->getID(), this->leftChild->getX(), this->leftChild->getY() );
-        std::printf( "\t\"%d-(%d,%d)\" -> \"%d-(%d,%d)\" [color=red];\n",
-            this->ID, this->x, this->y,
-            this->rightChild->getID(), this->rightChild->getX(), this->rightChild->getY() );
-        // recursion
-        this->rightChild->dumpDOT();
-        this->leftChild->dumpDOT();
+    // copy the coordinates once the order is final
+    this->xs.resize( this->keypoints.size() );
+    this->ys.resize( this->keypoints.size() );
+    for( int i=0; i < this->keypoints.size(); i++ ){
+        this->xs[i] = this->keypoints[i].pt.x;
+        this->ys[i] = this->keypoints[i].pt.y;
     }
 }
 
-/* Node Getters / setters */
+/* Tree Methods */
 
-double KdTreeNode::getDistanceTo( int x, int y){
-    // pythagoras without squareroot = squared distance
-    double d = std::pow( this->getX() - x,2) + pow(this->getY() - y,2);
-    if( d < 0.0 ){
-        // euclidian vector direction does not matter
-        return -1.0*d;
-    }
-    return d;
+std::string KdTree::getName(){
+    return "kdtree";
 }
 
-double KdTreeNode::getDistanceTo( KdTreeNode& node){
-    return this->getDistanceTo( node.getX(), node.getY() );
+void KdTree::dumpDOT( ){
+    printf( "digraph graphname {\n" );
+    this->dumpDOTRec( 0, this->keypoints.size(), 0 );
+    printf( "}\n" );
 }
 
-int KdTreeNode::getID(){ 
-    return this->ID; 
-}
-int KdTreeNode::getX(){ 
-    return this->x; 
-}
-int KdTreeNode::getY(){ 
-    return this->y; 
-}
-std::shared_ptr<KdTreeNode> KdTreeNode::getLeftChild(){ 
-    if( this->leaf() ){
-        throw std::runtime_error("this node is a leaf");
+cv::KeyPoint KdTree::nearestNeighborSearch( int x, int y){
+    int index = this->nearestNeighborIndex( x, y );
+    if( index < 0 ){
+        throw std::runtime_error("no result found");
     }
-    return this->leftChild; 
-}
-std::shared_ptr<KdTreeNode> KdTreeNode::getRightChild(){ 
-    if( this->leaf() ){
-        throw std::runtime_error("this node is a leaf");
+    return this->keypoints[index];
+}
+
+int KdTree::nearestNeighborIndex( float x, float y ){
+    // pending subtrees together with the squared distance to their splitting axis
+    struct Range{
+        int begin;
+        int end;
+        int depth;
+        float axisDistance;
+    };
+    Range stack[KdTree::maxDepth];
+    int top = 0;
+
+    const float* xs = this->xs.data();
+    const float* ys = this->ys.data();
+    int best = -1;
+    float bestDistance = std::numeric_limits<float>::infinity();
+
+    if( this->xs.size() > 0 ){
+        stack[top++] = { 0, (int) this->xs.size(), 0, 0.0f };
+    }
+    while( top > 0 ){
+        Range r = stack[--top];
+        if( r.axisDistance >= bestDistance ){
+            // the circle around the search point does not cross the axis
+            continue;
+        }
+        while( r.begin < r.end ){
+            int median = r.begin + (r.end - r.begin) / 2;
+            float dx = xs[median] - x;
+            float dy = ys[median] - y;
+            float d = dx*dx + dy*dy;
+            if( d < bestDistance ){
+                bestDistance = d;
+                best = median;
+            }
+
+            // descend on the side where the search point would be inserted,
+            // remember the other side in case there is doubt
+            float axis = ( r.depth % 2 == 0 ) ? x - xs[median] : y - ys[median];
+            Range near;
+            Range far;
+            if( axis > 0 ){
+                near = { median+1, r.end, r.depth+1, 0.0f };
+                far = { r.begin, median, r.depth+1, axis*axis };
+            }else{
+                near = { r.begin, median, r.depth+1, 0.0f };
+                far = { median+1, r.end, r.depth+1, axis*axis };
+            }
+            if( far.begin < far.end && far.axisDistance < bestDistance ){
+                stack[top++] = far;
+            }
+            r = near;
+        }
     }
-    return this->rightChild; 
-}
-cv::KeyPoint KdTreeNode::getKeyPoint(){ 
-    return this->keypoint; 
+    return best;
 }
 
-void KdTreeNode::setID( int id ){ 
-    this->ID = id; 
+bool KdTree::hasNeighborWithin( float x, float y, double radius ){
+    return this->rangeSearch( x, y, radius*radius, 1 ) > 0;
 }
 
-
-/* Tree Constructors */
-
-KdTree::KdTree(){
+int KdTree::countWithin( float x, float y, double radius ){
+    return this->rangeSearch( x, y, radius*radius, std::numeric_limits<int>::max() );
 }
-KdTree::KdTree( std::vector<cv::KeyPoint>& keypoints){
-    KdTreeNode root = this->build( keypoints, 0 );
-    this->root = std::make_shared<KdTreeNode>(std::move(root));;
-    if( this->root->empty() ){
-        throw std::runtime_error("root node is empty");
-    }
-}
-
-/* Tree Methods */
 
-void KdTree::dumpDOT( ){
-    this->root->autoID(0);
-    printf( "digraph graphname {\n" );
-    this->root->dumpDOT();
-    printf( "}\n" );
+int KdTree::size(){
+    return this->keypoints.size();
 }
 
-cv::KeyPoint KdTree::nearestNeighborSearch( int x, int y){
-    KdTreeNode nullNode;
-    KdTreeNode result;
-    result = this->nearestNeighborSearchRec( this->root, x, y, 0, nullNode, std::numeric_limits<double>::infinity());
-    if( result.empty() ){
-        throw std::runtime_error("no result found");
-    }
-    return result.getKeyPoint();
+const cv::KeyPoint& KdTree::getKeyPoint( int index ){
+    return this->keypoints[index];
 }
 
 /* Treee Helpers */
@@ -171,111 +135,88 @@ bool KdTree::compareKeyPointByY( cv::KeyPoint& lhs, cv::KeyPoint& rhs ){
 
 /* Tree KD Datastructure */
 
-KdTreeNode KdTree::build( std::vector<cv::KeyPoint> keypoints, int depth ){
-    if( keypoints.size() == 0 ){
-        KdTreeNode node;
-        return node;
-    }
-    if( keypoints.size() == 1 ){
-        KdTreeNode node( keypoints[0] );
-        return node;
-    }
-    // cycle axis
-    int axis = depth % 2;
-    std::vector<cv::KeyPoint> leftPoints;
-    std::vector<cv::KeyPoint> rightPoints;
-    
-    // sort by axis. ok since keypoints passed by value
-    if( axis == 0 ){
-        std::sort( keypoints.begin(), keypoints.end(), KdTree::compareKeyPointByX );
-    }else{
-        std::sort( keypoints.begin(), keypoints.end(), KdTree::compareKeyPointByY );
-    }
-    int medianIdx = keypoints.size() / 2;
-
-    // sort keypints into left and right side of median
-    int i;
-    for(i = 0; i < medianIdx; i++) {
-        leftPoints.push_back( keypoints[i] );
-    }
-    for(i = medianIdx+1; i < keypoints.size(); i++) {
-        rightPoints.push_back( keypoints[i] );
-    }
-    if( leftPoints.size() + rightPoints.size() + 1 != keypoints.size() ){
-        throw std::runtime_error("size missmatch of left+right");
-    }
-    
-    // recursion
-    KdTreeNode leftNode = this->build( leftPoints, depth+1 );
-    KdTreeNode rightNode = this->build( rightPoints, depth+1 );
-    // fill node
-    KdTreeNode node( keypoints[medianIdx], leftNode, rightNode );
-    return node;
-}
-
-KdTreeNode KdTree::nearestNeighborSearchRec( std::shared_ptr<KdTreeNode> currentNode, int searchX, int searchY, 
-    int depth, KdTreeNode bestNode, double bestDistance ){
-
-    // check if this node is better than the others
-    double currentDistance = currentNode->getDistanceTo( searchX, searchY );
-    if( currentDistance < bestDistance ){
-        bestDistance = currentDistance;
-        bestNode = *currentNode;
-    }
-
-    // leaf nodes
-    if( currentNode->leaf() ){
-        return bestNode;
-    }
-    
-    if( currentNode->getLeftChild()->leaf() && currentNode->getRightChild()->leaf() ){
-        // cannot descend into children of leaf nodes
-        return bestNode;
+void KdTree::build( int begin, int end, int depth ){
+    if( end - begin < 2 ){
+        return;
     }
-    std::shared_ptr<KdTreeNode> visitFirst;
-    std::shared_ptr<KdTreeNode> visitLast;
-    // visit first the side where the search point would be inserted
+    // only the median has to be in place, both sides stay unsorted
+    auto first = this->keypoints.begin();
+    int median = begin + (end - begin) / 2;
     if( depth % 2 == 0 ){
-        if( searchX > currentNode->getX() ){
-            visitFirst = currentNode->getRightChild();
-            visitLast = currentNode->getLeftChild();
-        }else{
-            visitFirst = currentNode->getLeftChild();
-            visitLast = currentNode->getRightChild();
-        }
+        std::nth_element( first+begin, first+median, first+end,
+            []( const cv::KeyPoint& a, const cv::KeyPoint& b ){ return a.pt.x < b.pt.x; } );
     }else{
-        if( searchY > currentNode->getY() ){
-            visitFirst = currentNode->getRightChild();
-            visitLast = currentNode->getLeftChild();
-        }else{
-            visitFirst = currentNode->getLeftChild();
-            visitLast = currentNode->getRightChild();
+        std::nth_element( first+begin, first+median, first+end,
+            []( const cv::KeyPoint& a, const cv::KeyPoint& b ){ return a.pt.y < b.pt.y; } );
+    }
+    this->build( begin, median, depth+1 );
+    this->build( median+1, end, depth+1 );
+}
+
+int KdTree::rangeSearch( float x, float y, float squaredRadius, int limit ){
+    // counts points strictly closer than the radius, stops once limit is reached
+    struct Range{
+        int begin;
+        int end;
+        int depth;
+    };
+    Range stack[KdTree::maxDepth];
+    int top = 0;
+
+    const float* xs = this->xs.data();
+    const float* ys = this->ys.data();
+    int count = 0;
+
+    if( this->xs.size() > 0 ){
+        stack[top++] = { 0, (int) this->xs.size(), 0 };
+    }
+    while( top > 0 ){
+        Range r = stack[--top];
+        while( r.begin < r.end ){
+            int median = r.begin + (r.end - r.begin) / 2;
+            float dx = xs[median] - x;
+            float dy = ys[median] - y;
+            if( dx*dx + dy*dy < squaredRadius ){
+                if( ++count >= limit ){
+                    return count;
+                }
+            }
+
+            // the other side only matters if the circle crosses the axis
+            float axis = ( r.depth % 2 == 0 ) ? x - xs[median] : y - ys[median];
+            Range near;
+            Range far;
+            if( axis > 0 ){
+                near = { median+1, r.end, r.depth+1 };
+                far = { r.begin, median, r.depth+1 };
+            }else{
+                near = { r.begin, median, r.depth+1 };
+                far = { median+1, r.end, r.depth+1 };
+            }
+            if( far.begin < far.end && axis*axis < squaredRadius ){
+                stack[top++] = far;
+            }
+            r = near;
         }
     }
-    // recursion: visit first child
-    bestNode = this->nearestNeighborSearchRec( visitFirst, searchX, searchY, 
-        depth+1, bestNode, bestDistance);
-
-    // check if there may be a closer point on the other side
-    // create a circle around the search point with currentNode on that circle
-    double radius = sqrt(bestNode.getDistanceTo( searchX, searchY ));
+    return count;
+}
 
-    double distanceAxis; // distance from current node to the splitting axis
-    if( depth % 2 == 0 ){
-        distanceAxis = (double) searchX - currentNode->getX();
-    }else{
-        distanceAxis = (double) searchY - currentNode->getY();
-    }
-    if( distanceAxis < 0 ){
-        // ignore direction
-        distanceAxis = -1.0*distanceAxis;
+void KdTree::dumpDOTRec( int begin, int end, int depth ){
+    if( end - begin < 2 ){
+        return;
     }
-
-    // check if the circle crosses the boundary of the current splitting axis
-    if( distanceAxis < radius ){
-        // visit other side if there is doubt: recursion
-        bestNode = this->nearestNeighborSearchRec( visitLast, searchX, searchY, 
-            depth+1, bestNode, bestDistance);
+    int median = begin + (end - begin) / 2;
+    int left = begin + (median - begin) / 2;
+    int right = median+1 + (end - median-1) / 2;
+    std::printf( "\t\"%d-(%d,%d)\" -> \"%d-(%d,%d)\" [color=blue];\n",
+        median, (int) this->keypoints[median].pt.x, (int) this->keypoints[median].pt.y,
+        left, (int) this->keypoints[left].pt.x, (int) this->keypoints[left].pt.y );
+    if( right < end ){
+        std::printf( "\t\"%d-(%d,%d)\" -> \"%d-(%d,%d)\" [color=red];\n",
+            median, (int) this->keypoints[median].pt.x, (int) this->keypoints[median].pt.y,
+            right, (int) this->keypoints[right].pt.x, (int) this->keypoints[right].pt.y );
     }
-    return bestNode;
+    this->dumpDOTRec( median+1, end, depth+1 );
+    this->dumpDOTRec( begin, median, depth+1 );
 }
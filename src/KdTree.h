@@ -2,67 +2,51 @@
 #define KD_TREE_H
 
 #include <string>
-#include <memory>
+#include <vector>
 #include <opencv2/opencv.hpp>
 
+#include "SpatialIndex.h"
 
-class KdTreeNode{
-
-public:
-    KdTreeNode();
-    KdTreeNode( cv::KeyPoint& keypoint );
-    KdTreeNode( cv::KeyPoint& keypoint,  KdTreeNode& left, KdTreeNode& right );
-    KdTreeNode( int x, int y, KdTreeNode& left, KdTreeNode& right );
-
-    int autoID( int previous );
-    void dumpDOT( );
-
-    double getDistanceTo( int x, int y );
-    double getDistanceTo( KdTreeNode& node );
-    bool empty();
-    bool leaf();
-
-    int getID();
-    int getX();
-    int getY();
-    std::shared_ptr<KdTreeNode> getLeftChild();
-    std::shared_ptr<KdTreeNode> getRightChild();
-    cv::KeyPoint getKeyPoint();
-
-    void setID( int id );
-
-private:
-    int x;
-    int y;
-    int ID;
-    bool isEmpty;
-    bool isLeaf;
-    cv::KeyPoint keypoint;
-    std::shared_ptr<KdTreeNode> leftChild;
-    std::shared_ptr<KdTreeNode> rightChild;
-};
-
-
-class KdTree{
+/*
+ * Implicit 2d-tree stored in flat arrays.
+ * The node of the index range [begin,end) sits at its median (begin+end)/2,
+ * its children are the ranges [begin,median) and [median+1,end).
+ * The split axis alternates between x (even depth) and y (odd depth).
+ */
+class KdTree : public SpatialIndex{
 
 public:
     KdTree();
     KdTree( std::vector<cv::KeyPoint>& keypoints);
+    // treeOrder: the keypoints come from getKeyPoint() of a built tree, skips the build
+    KdTree( std::vector<cv::KeyPoint>& keypoints, bool treeOrder );
 
+    std::string getName();
     void dumpDOT( );
     cv::KeyPoint nearestNeighborSearch( int x, int y);
+    int nearestNeighborIndex( float x, float y );
+    bool hasNeighborWithin( float x, float y, double radius );
+    int countWithin( float x, float y, double radius );
 
+    int size();
+    const cv::KeyPoint& getKeyPoint( int index );
 
     static bool compareKeyPointByX( cv::KeyPoint& lhs, cv::KeyPoint& rhs );
     static bool compareKeyPointByY( cv::KeyPoint& lhs, cv::KeyPoint& rhs );
 
-    KdTreeNode build( std::vector<cv::KeyPoint> keypoints, int depth );
-    KdTreeNode nearestNeighborSearchRec( std::shared_ptr<KdTreeNode> currentNode, int searchX, int searchY, 
-        int depth, KdTreeNode bestNode, double bestDistance );
+    // median splits keep the depth at log2(n)+1, this is plenty
+    static const int maxDepth = 64;
 
 private:
-    std::shared_ptr<KdTreeNode> root;
+    void build( int begin, int end, int depth );
+    int rangeSearch( float x, float y, float squaredRadius, int limit );
+    void dumpDOTRec( int begin, int end, int depth );
+
+    // coordinates in tree order, kept apart from the keypoints for the search loop
+    std::vector<float> xs;
+    std::vector<float> ys;
+    std::vector<cv::KeyPoint> keypoints;
 };
 
 
-#endif // KD_TREE_H
\ No newline at end of file
+#endif // KD_TREE_H
@@ -0,0 +1,134 @@
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <cerrno>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <thread>
+#include <functional>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <opencv2/opencv.hpp>
+
+#include "KeyPointCache.h"
+
+static const char cacheMagic[8] = { 'L', 'F', '2', 'K', 'P', 'C', 0, 0 };
+
+
+KeyPointCache::KeyPointCache( std::string directory ){
+    this->directory = directory;
+    this->warned = false;
+    // the parent has to exist, an existing directory is fine
+    if( mkdir( directory.c_str(), 0755 ) != 0 && errno != EEXIST ){
+        this->warnOnce( "cannot create " + directory + ": " + std::strerror( errno ) );
+    }
+}
+
+std::string KeyPointCache::getDirectory(){
+    return this->directory;
+}
+
+std::string KeyPointCache::getPath( uint64_t key ){
+    char name[32];
+    std::snprintf( name, sizeof(name), "%016llx.kpc", (unsigned long long) key );
+    return this->directory + "/" + name;
+}
+
+bool KeyPointCache::load( uint64_t key, std::vector<cv::KeyPoint>& keypoints, bool& treeOrder ){
+    int fd = open( this->getPath( key ).c_str(), O_RDONLY );
+    if( fd < 0 ){
+        return false;
+    }
+    struct stat st;
+    if( fstat( fd, &st ) != 0 || st.st_size < (off_t) sizeof(Header) ){
+        close( fd );
+        return false;
+    }
+    void* map = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close( fd );
+    if( map == MAP_FAILED ){
+        return false;
+    }
+
+    const Header* header = (const Header*) map;
+    bool valid = std::memcmp( header->magic, cacheMagic, sizeof(cacheMagic) ) == 0
+        && header->version == KeyPointCache::version
+        && header->key == key
+        && (uint64_t) st.st_size == sizeof(Header) + header->count * sizeof(Record);
+    if( valid ){
+        const Record* records = (const Record*) ( (const char*) map + sizeof(Header) );
+        keypoints.clear();
+        keypoints.reserve( header->count );
+        for( uint64_t i=0; i < header->count; i++ ){
+            const Record& r = records[i];
+            keypoints.push_back( cv::KeyPoint( r.x, r.y, r.size, r.angle, r.response, r.octave, r.classId ) );
+        }
+        treeOrder = ( header->flags & 1 ) != 0;
+    }
+    munmap( map, st.st_size );
+    return valid;
+}
+
+bool KeyPointCache::store( uint64_t key, std::vector<cv::KeyPoint>& keypoints, bool treeOrder ){
+    Header header;
+    std::memset( &header, 0, sizeof(header) );
+    std::memcpy( header.magic, cacheMagic, sizeof(cacheMagic) );
+    header.version = KeyPointCache::version;
+    header.flags = treeOrder ? 1 : 0;
+    header.key = key;
+    header.count = keypoints.size();
+
+    std::vector<Record> records( keypoints.size() );
+    for( int i=0; i < keypoints.size(); i++ ){
+        const cv::KeyPoint& kp = keypoints[i];
+        records[i] = { kp.pt.x, kp.pt.y, kp.size, kp.angle, kp.response, kp.octave, kp.class_id };
+    }
+
+    // write aside and rename, concurrent runs never see a partial file
+    std::string path = this->getPath( key );
+    std::ostringstream tmp;
+    tmp << path << ".tmp" << getpid() << "-" << std::hash<std::thread::id>()( std::this_thread::get_id() );
+    std::ofstream out( tmp.str(), std::ios::binary | std::ios::trunc );
+    out.write( (const char*) &header, sizeof(header) );
+    out.write( (const char*) records.data(), records.size() * sizeof(Record) );
+    out.close();
+    if( ! out || std::rename( tmp.str().c_str(), path.c_str() ) != 0 ){
+        std::remove( tmp.str().c_str() );
+        this->warnOnce( "cannot write " + path );
+        return false;
+    }
+    return true;
+}
+
+void KeyPointCache::warnOnce( std::string message ){
+    if( ! this->warned.exchange( true ) ){
+        std::cerr << "Cache Warning: " << message << ", keypoints are not cached\n";
+    }
+}
+
+bool KeyPointCache::readFile( std::string fileName, std::vector<unsigned char>& content ){
+    std::ifstream in( fileName, std::ios::binary | std::ios::ate );
+    if( ! in ){
+        return false;
+    }
+    content.resize( in.tellg() );
+    in.seekg( 0 );
+    in.read( (char*) content.data(), content.size() );
+    return (bool) in;
+}
+
+uint64_t KeyPointCache::hash( const void* data, std::size_t size, uint64_t seed ){
+    // FNV-1a, chain calls by passing the last result as seed
+    const unsigned char* bytes = (const unsigned char*) data;
+    uint64_t h = seed;
+    for( std::size_t i=0; i < size; i++ ){
+        h ^= bytes[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
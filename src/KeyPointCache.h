@@ -0,0 +1,61 @@
+#ifndef KEY_POINT_CACHE_H
+#define KEY_POINT_CACHE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <opencv2/opencv.hpp>
+
+/*
+ * Directory of keypoint files, one per key. A file is a fixed header followed
+ * by packed keypoint records and is read back through mmap. The key is the
+ * FNV-1a hash of the image file content continued over the detector settings,
+ * so any change of either is a miss. Keypoints may be stored in the order of a
+ * built KdTree, which then needs no build when loaded.
+ */
+class KeyPointCache{
+
+public:
+    KeyPointCache( std::string directory );
+
+    std::string getDirectory();
+    std::string getPath( uint64_t key );
+
+    // false on a miss or an unreadable file
+    bool load( uint64_t key, std::vector<cv::KeyPoint>& keypoints, bool& treeOrder );
+    // best effort, a failed write leaves no file behind and warns once
+    bool store( uint64_t key, std::vector<cv::KeyPoint>& keypoints, bool treeOrder );
+
+    static bool readFile( std::string fileName, std::vector<unsigned char>& content );
+    static uint64_t hash( const void* data, std::size_t size, uint64_t seed = KeyPointCache::hashSeed );
+
+    static const uint64_t hashSeed = 14695981039346656037ULL;
+    static const uint32_t version = 1;
+
+private:
+    struct Header{
+        char magic[8];
+        uint32_t version;
+        uint32_t flags; // bit 0: KdTree order
+        uint64_t key;
+        uint64_t count;
+    };
+    struct Record{
+        float x;
+        float y;
+        float size;
+        float angle;
+        float response;
+        int32_t octave;
+        int32_t classId;
+    };
+
+    // a cache that cannot be written says so once, not once per image
+    void warnOnce( std::string message );
+
+    std::string directory;
+    std::atomic<bool> warned;
+};
+
+#endif // KEY_POINT_CACHE_H
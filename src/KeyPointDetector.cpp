@@ -0,0 +1,132 @@
+#include <string>
+#include <vector>
+#include <memory>
+#include <stdexcept>
+#include <opencv2/opencv.hpp>
+#include <opencv2/features2d.hpp>
+
+#include "KeyPointDetector.h"
+
+/*
+
+    Key Point Detector
+
+ */
+
+KeyPointDetector::KeyPointDetector(){
+}
+
+KeyPointDetector::~KeyPointDetector(){
+}
+
+std::vector<std::string> KeyPointDetector::getNames(){
+    return { "orb", "fast", "agast", "gftt", "harris" };
+}
+
+bool KeyPointDetector::isValidName( std::string name ){
+    for( auto& n : KeyPointDetector::getNames() ){
+        if( n == name ){
+            return true;
+        }
+    }
+    return false;
+}
+
+std::shared_ptr<KeyPointDetector> KeyPointDetector::create( std::string name, 
+        int featureCount, int fastThreshold, int scaleLevels ){
+    if( name == "orb" ){
+        return std::make_shared<OrbDetector>( featureCount, fastThreshold, scaleLevels );
+    }else if( name == "fast" ){
+        return std::make_shared<FastDetector>( featureCount, fastThreshold );
+    }else if( name == "agast" ){
+        return std::make_shared<AgastDetector>( featureCount, fastThreshold );
+    }else if( name == "gftt" ){
+        return std::make_shared<GfttDetector>( featureCount, false );
+    }else if( name == "harris" ){
+        return std::make_shared<GfttDetector>( featureCount, true );
+    }
+    throw std::invalid_argument( "unknown detector " + name );
+}
+
+
+/*
+
+    ORB: FAST corners on a scale pyramid, ranked by the Harris score
+
+ */
+
+OrbDetector::OrbDetector( int featureCount, int fastThreshold, int scaleLevels ){
+    this->detector = cv::ORB::create( featureCount, 1.2f, scaleLevels, 31, 0, 2, 
+        cv::ORB::HARRIS_SCORE, 31, fastThreshold );
+}
+
+std::string OrbDetector::getName(){
+    return "orb";
+}
+
+void OrbDetector::detect( cv::Mat& mat, std::vector<cv::KeyPoint>& keypoints ){
+    this->detector->detect( mat, keypoints );
+}
+
+
+/*
+
+    FAST: single scale, the strongest featureCount corners are kept
+
+ */
+
+FastDetector::FastDetector( int featureCount, int fastThreshold ){
+    this->featureCount = featureCount;
+    this->detector = cv::FastFeatureDetector::create( fastThreshold, true );
+}
+
+std::string FastDetector::getName(){
+    return "fast";
+}
+
+void FastDetector::detect( cv::Mat& mat, std::vector<cv::KeyPoint>& keypoints ){
+    this->detector->detect( mat, keypoints );
+    // bound the matching cost like the other detectors do
+    cv::KeyPointsFilter::retainBest( keypoints, this->featureCount );
+}
+
+
+/*
+
+    AGAST: FAST variant with an adaptive decision tree
+
+ */
+
+AgastDetector::AgastDetector( int featureCount, int threshold ){
+    this->featureCount = featureCount;
+    this->detector = cv::AgastFeatureDetector::create( threshold, true );
+}
+
+std::string AgastDetector::getName(){
+    return "agast";
+}
+
+void AgastDetector::detect( cv::Mat& mat, std::vector<cv::KeyPoint>& keypoints ){
+    this->detector->detect( mat, keypoints );
+    cv::KeyPointsFilter::retainBest( keypoints, this->featureCount );
+}
+
+
+/*
+
+    GFTT: Shi-Tomasi corners, or Harris corners with useHarris
+
+ */
+
+GfttDetector::GfttDetector( int featureCount, bool useHarris ){
+    this->useHarris = useHarris;
+    this->detector = cv::GFTTDetector::create( featureCount, 0.01, 1, 3, useHarris );
+}
+
+std::string GfttDetector::getName(){
+    return this->useHarris ? "harris" : "gftt";
+}
+
+void GfttDetector::detect( cv::Mat& mat, std::vector<cv::KeyPoint>& keypoints ){
+    this->detector->detect( mat, keypoints );
+}
@@ -0,0 +1,73 @@
+#ifndef KEY_POINT_DETECTOR_H
+#define KEY_POINT_DETECTOR_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <opencv2/opencv.hpp>
+#include <opencv2/features2d.hpp>
+
+class KeyPointDetector{
+
+public:
+    KeyPointDetector();
+    virtual ~KeyPointDetector();
+
+    virtual std::string getName() = 0;
+    virtual void detect( cv::Mat& mat, std::vector<cv::KeyPoint>& keypoints ) = 0;
+
+    static std::shared_ptr<KeyPointDetector> create( std::string name, 
+            int featureCount, int fastThreshold, int scaleLevels );
+    static std::vector<std::string> getNames();
+    static bool isValidName( std::string name );
+};
+
+
+class OrbDetector : public KeyPointDetector{
+
+public:
+    OrbDetector( int featureCount, int fastThreshold, int scaleLevels );
+    std::string getName();
+    void detect( cv::Mat& mat, std::vector<cv::KeyPoint>& keypoints );
+
+private:
+    cv::Ptr<cv::FeatureDetector> detector;
+};
+
+class FastDetector : public KeyPointDetector{
+
+public:
+    FastDetector( int featureCount, int fastThreshold );
+    std::string getName();
+    void detect( cv::Mat& mat, std::vector<cv::KeyPoint>& keypoints );
+
+private:
+    int featureCount;
+    cv::Ptr<cv::FeatureDetector> detector;
+};
+
+class AgastDetector : public KeyPointDetector{
+
+public:
+    AgastDetector( int featureCount, int threshold );
+    std::string getName();
+    void detect( cv::Mat& mat, std::vector<cv::KeyPoint>& keypoints );
+
+private:
+    int featureCount;
+    cv::Ptr<cv::FeatureDetector> detector;
+};
+
+class GfttDetector : public KeyPointDetector{
+
+public:
+    GfttDetector( int featureCount, bool useHarris );
+    std::string getName();
+    void detect( cv::Mat& mat, std::vector<cv::KeyPoint>& keypoints );
+
+private:
+    bool useHarris;
+    cv::Ptr<cv::FeatureDetector> detector;
+};
+
+#endif // KEY_POINT_DETECTOR_H
@@ -0,0 +1,207 @@
+#include <stdexcept>
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+
+#include "KeyPointGrid.h"
+
+
+KeyPointGrid::KeyPointGrid( std::vector<cv::KeyPoint>& keypoints, double cellSize ){
+    if( keypoints.size() == 0 ){
+        throw std::runtime_error("no keypoints to index");
+    }
+    if( !( cellSize > 0.0 ) ){
+        cellSize = 1.0;
+    }
+
+    // bounding box of the keypoints
+    double minX = keypoints[0].pt.x;
+    double minY = keypoints[0].pt.y;
+    double maxX = minX;
+    double maxY = minY;
+    for( auto& kp : keypoints ){
+        minX = std::min( minX, (double) kp.pt.x );
+        minY = std::min( minY, (double) kp.pt.y );
+        maxX = std::max( maxX, (double) kp.pt.x );
+        maxY = std::max( maxY, (double) kp.pt.y );
+    }
+    this->originX = minX;
+    this->originY = minY;
+
+    // small radii on large images would allocate mostly empty cells
+    long int cellLimit = std::max( (long int) keypoints.size() * KeyPointGrid::maxCellsPerPoint, 
+        (long int) KeyPointGrid::minCellLimit );
+    while( true ){
+        this->cellSize = cellSize;
+        this->invCellSize = 1.0 / cellSize;
+        this->columns = (int) std::floor( (maxX - minX) * this->invCellSize ) + 1;
+        this->rows = (int) std::floor( (maxY - minY) * this->invCellSize ) + 1;
+        if( (long int) this->columns * this->rows <= cellLimit ){
+            break;
+        }
+        cellSize = cellSize * 2;
+    }
+
+    // counting sort of the keypoints into the cells
+    int cellCount = this->columns * this->rows;
+    std::vector<int> cellOf( keypoints.size() );
+    this->cellStart.assign( cellCount+1, 0 );
+    for( int i=0; i < keypoints.size(); i++ ){
+        int c = this->cellRow( keypoints[i].pt.y ) * this->columns + this->cellColumn( keypoints[i].pt.x );
+        cellOf[i] = c;
+        this->cellStart[c+1]++;
+    }
+    for( int c=0; c < cellCount; c++ ){
+        this->cellStart[c+1] += this->cellStart[c];
+    }
+    std::vector<int> fill( this->cellStart.begin(), this->cellStart.end()-1 );
+    this->keypoints.resize( keypoints.size() );
+    this->xs.resize( keypoints.size() );
+    this->ys.resize( keypoints.size() );
+    for( int i=0; i < keypoints.size(); i++ ){
+        int pos = fill[ cellOf[i] ]++;
+        this->keypoints[pos] = keypoints[i];
+        this->xs[pos] = keypoints[i].pt.x;
+        this->ys[pos] = keypoints[i].pt.y;
+    }
+}
+
+std::string KeyPointGrid::getName(){
+    return "grid";
+}
+
+cv::KeyPoint KeyPointGrid::nearestNeighborSearch( int x, int y ){
+    int index = this->nearestNeighborIndex( x, y );
+    if( index < 0 ){
+        throw std::runtime_error("no result found");
+    }
+    return this->keypoints[index];
+}
+
+int KeyPointGrid::nearestNeighborIndex( float x, float y ){
+    // visit rings of cells around the cell of the search point, the cells of
+    // ring r are at least (r-1) cells away from the search point
+    long int cx = (long int) std::floor( (x - this->originX) * this->invCellSize );
+    long int cy = (long int) std::floor( (y - this->originY) * this->invCellSize );
+    long int maxRing = std::max( std::max( std::labs(cx), std::labs(this->columns-1 - cx) ), 
+        std::max( std::labs(cy), std::labs(this->rows-1 - cy) ) );
+
+    int best = -1;
+    float bestDistance = std::numeric_limits<float>::infinity();
+
+    for( long int ring = 0; ring <= maxRing; ring++ ){
+        if( best >= 0 && ring > 0 ){
+            double reach = (ring-1) * this->cellSize;
+            if( reach*reach >= bestDistance ){
+                break;
+            }
+        }
+        long int row0 = std::max( cy - ring, 0L );
+        long int row1 = std::min( cy + ring, this->rows-1L );
+        long int col0 = std::max( cx - ring, 0L );
+        long int col1 = std::min( cx + ring, this->columns-1L );
+        for( long int row = row0; row <= row1; row++ ){
+            if( row == cy - ring || row == cy + ring ){
+                // top and bottom row of the ring
+                for( long int col = col0; col <= col1; col++ ){
+                    this->nearestInCell( row * this->columns + col, x, y, best, bestDistance );
+                }
+            }else{
+                // only the left and right border cells
+                if( cx - ring >= 0 && cx - ring < this->columns ){
+                    this->nearestInCell( row * this->columns + cx - ring, x, y, best, bestDistance );
+                }
+                if( cx + ring >= 0 && cx + ring < this->columns ){
+                    this->nearestInCell( row * this->columns + cx + ring, x, y, best, bestDistance );
+                }
+            }
+        }
+    }
+    return best;
+}
+
+bool KeyPointGrid::hasNeighborWithin( float x, float y, double radius ){
+    return this->rangeSearch( x, y, radius, 1 ) > 0;
+}
+
+int KeyPointGrid::countWithin( float x, float y, double radius ){
+    return this->rangeSearch( x, y, radius, std::numeric_limits<int>::max() );
+}
+
+int KeyPointGrid::size(){
+    return this->keypoints.size();
+}
+int KeyPointGrid::getColumns(){
+    return this->columns;
+}
+int KeyPointGrid::getRows(){
+    return this->rows;
+}
+double KeyPointGrid::getCellSize(){
+    return this->cellSize;
+}
+const cv::KeyPoint& KeyPointGrid::getKeyPoint( int index ){
+    return this->keypoints[index];
+}
+
+/* Grid Helpers */
+
+int KeyPointGrid::cellColumn( double x ){
+    int col = (int) std::floor( (x - this->originX) * this->invCellSize );
+    return std::min( std::max( col, 0 ), this->columns-1 );
+}
+int KeyPointGrid::cellRow( double y ){
+    int row = (int) std::floor( (y - this->originY) * this->invCellSize );
+    return std::min( std::max( row, 0 ), this->rows-1 );
+}
+
+void KeyPointGrid::nearestInCell( int cell, float x, float y, int& best, float& bestDistance ){
+    for( int i = this->cellStart[cell]; i < this->cellStart[cell+1]; i++ ){
+        float dx = this->xs[i] - x;
+        float dy = this->ys[i] - y;
+        float d = dx*dx + dy*dy;
+        if( d < bestDistance ){
+            bestDistance = d;
+            best = i;
+        }
+    }
+}
+
+int KeyPointGrid::rangeSearch( float x, float y, double radius, int limit ){
+    // counts points strictly closer than the radius, stops once limit is reached
+    float squaredRadius = radius*radius;
+    if( x + radius < this->originX || y + radius < this->originY ){
+        return 0;
+    }
+    double right = this->originX + this->columns * this->cellSize;
+    double bottom = this->originY + this->rows * this->cellSize;
+    if( x - radius >= right || y - radius >= bottom ){
+        return 0;
+    }
+    int col0 = this->cellColumn( x - radius );
+    int col1 = this->cellColumn( x + radius );
+    int row0 = this->cellRow( y - radius );
+    int row1 = this->cellRow( y + radius );
+
+    const float* xs = this->xs.data();
+    const float* ys = this->ys.data();
+    const int* cellStart = this->cellStart.data();
+    int count = 0;
+    for( int row = row0; row <= row1; row++ ){
+        // the cells of one row are contiguous
+        int begin = cellStart[ row * this->columns + col0 ];
+        int end = cellStart[ row * this->columns + col1 + 1 ];
+        for( int i = begin; i < end; i++ ){
+            float dx = xs[i] - x;
+            float dy = ys[i] - y;
+            if( dx*dx + dy*dy < squaredRadius ){
+                if( ++count >= limit ){
+                    return count;
+                }
+            }
+        }
+    }
+    return count;
+}
@@ -0,0 +1,54 @@
+#ifndef KEY_POINT_GRID_H
+#define KEY_POINT_GRID_H
+
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+#include "SpatialIndex.h"
+
+/*
+ * Uniform grid over the bounding box of the keypoints.
+ * The points are packed cell by cell, cell c holds the points [cellStart[c], cellStart[c+1]).
+ */
+class KeyPointGrid : public SpatialIndex{
+
+public:
+    KeyPointGrid( std::vector<cv::KeyPoint>& keypoints, double cellSize );
+
+    std::string getName();
+    cv::KeyPoint nearestNeighborSearch( int x, int y );
+    int nearestNeighborIndex( float x, float y );
+    bool hasNeighborWithin( float x, float y, double radius );
+    int countWithin( float x, float y, double radius );
+
+    int size();
+    int getColumns();
+    int getRows();
+    double getCellSize();
+    const cv::KeyPoint& getKeyPoint( int index );
+
+    // the cell size grows until there are at most this many cells per keypoint
+    static const int maxCellsPerPoint = 16;
+    static const int minCellLimit = 4096;
+
+private:
+    int cellColumn( double x );
+    int cellRow( double y );
+    void nearestInCell( int cell, float x, float y, int& best, float& bestDistance );
+    int rangeSearch( float x, float y, double radius, int limit );
+
+    double originX;
+    double originY;
+    double cellSize;
+    double invCellSize;
+    int columns;
+    int rows;
+    std::vector<int> cellStart;
+    // coordinates in cell order, kept apart from the keypoints for the search loop
+    std::vector<float> xs;
+    std::vector<float> ys;
+    std::vector<cv::KeyPoint> keypoints;
+};
+
+#endif // KEY_POINT_GRID_H
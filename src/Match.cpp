@@ -1,6 +1,5 @@
 #include <cstdio>
 #include <cmath>
-#include <opencv2/opencv.hpp>
 #include <limits>
 
 #include "Match.h"
@@ -13,14 +12,12 @@ Match::Match(){
     this->imageKeypointCount = 0;
     this->keypointMatchCount = 0;
     this->imageIndex = -1;
+    this->skipped = false;
 }
 
 
 /* Setters */
 
-void Match::setOutputMat( cv::Mat mat ){
-    this->outputMat = mat;
-}
 void Match::setFrameTimestamp( double ts ){
     this->frameTimestamp = ts;
 }
@@ -36,19 +33,16 @@ void Match::setImageKeypointCount( int nkp){
 void Match::setKeypointMatchCount( int nkpm){
     this->keypointMatchCount = nkpm;
 }
+void Match::setSkipped(){
+    this->skipped = true;
+}
 void Match::setImageIndex( int idx ){
     this->imageIndex = idx;
 }
-void Match::addMatchedKeypoint( cv::KeyPoint kp ){
-    this->matchedKeypoints.push_back( kp );
-}
 
 
 /* Getters */
 
-cv::Mat Match::getOutputMat(){
-    return this->outputMat;
-}
 double Match::getFrameTimestamp(){
     return this->frameTimestamp;
 }
@@ -67,8 +61,8 @@ int Match::getKeypointMatchCount(){
 int Match::getImageIndex(){
     return this->imageIndex;
 }
-std::vector< cv::KeyPoint > Match::getMatchedKeypoints(){
-    return this->matchedKeypoints;
+bool Match::isSkipped(){
+    return this->skipped;
 }
 
 double Match::getSnr(){
@@ -2,29 +2,26 @@
 #define MATCH_H
 
 #include <string>
-#include <opencv2/opencv.hpp>
 
 class Match{
 
 public:
     Match();
-    void setOutputMat( cv::Mat mat );
     void setFrameTimestamp( double ts );
     void setFrameIndex( long int idx );
     void setKeypointCount( int nkp);
     void setImageKeypointCount( int nkp);
     void setKeypointMatchCount( int nkpm);
     void setImageIndex( int idx );
-    void addMatchedKeypoint( cv::KeyPoint kp );
+    void setSkipped();
 
-    cv::Mat getOutputMat();
     double getFrameTimestamp();
     long int getFrameIndex();
     int getKeypointCount();
     int getImageKeypointCount();
     int getKeypointMatchCount();
     int getImageIndex();
-    std::vector< cv::KeyPoint > getMatchedKeypoints();
+    bool isSkipped();
 
     double getSnr();
     double getMatchRatio();
@@ -32,14 +29,13 @@ public:
     void dumpStatus( long totalFramesSeen, long totalKeypointHit, long totalKeypointMiss );
 
 private:
-    cv::Mat outputMat;
     double frameTimestamp;
     long int frameIndex;
     int keypointCount;
     int keypointMatchCount;
     int imageIndex;
     int imageKeypointCount;
-    std::vector< cv::KeyPoint > matchedKeypoints;
+    bool skipped; // placeholder for an image already found, not matched
 };
 
 #endif // MATCH_H
\ No newline at end of file
@@ -0,0 +1,39 @@
+#include <string>
+#include <vector>
+#include <memory>
+#include <stdexcept>
+#include <opencv2/opencv.hpp>
+
+#include "SpatialIndex.h"
+#include "KdTree.h"
+#include "KeyPointGrid.h"
+
+SpatialIndex::SpatialIndex(){
+}
+
+SpatialIndex::~SpatialIndex(){
+}
+
+std::vector<std::string> SpatialIndex::getNames(){
+    return { "kdtree", "grid" };
+}
+
+bool SpatialIndex::isValidName( std::string name ){
+    for( auto& n : SpatialIndex::getNames() ){
+        if( n == name ){
+            return true;
+        }
+    }
+    return false;
+}
+
+std::shared_ptr<SpatialIndex> SpatialIndex::create( std::string name, 
+        std::vector<cv::KeyPoint>& keypoints, double radius ){
+    if( name == "kdtree" ){
+        return std::make_shared<KdTree>( keypoints );
+    }else if( name == "grid" ){
+        // with the match radius as cell size a hit query looks at 3x3 cells at most
+        return std::make_shared<KeyPointGrid>( keypoints, radius );
+    }
+    throw std::invalid_argument( "unknown spatial index " + name );
+}
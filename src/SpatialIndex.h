@@ -0,0 +1,32 @@
+#ifndef SPATIAL_INDEX_H
+#define SPATIAL_INDEX_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <opencv2/opencv.hpp>
+
+/*
+ * Read-only lookup structure over the keypoints of an input image.
+ * Built once per image and shared by all copies of the image.
+ */
+class SpatialIndex{
+
+public:
+    SpatialIndex();
+    virtual ~SpatialIndex();
+
+    virtual std::string getName() = 0;
+    virtual cv::KeyPoint nearestNeighborSearch( int x, int y ) = 0;
+    virtual bool hasNeighborWithin( float x, float y, double radius ) = 0;
+    virtual int countWithin( float x, float y, double radius ) = 0;
+    virtual int size() = 0;
+    virtual const cv::KeyPoint& getKeyPoint( int index ) = 0;
+
+    static std::shared_ptr<SpatialIndex> create( std::string name, 
+            std::vector<cv::KeyPoint>& keypoints, double radius );
+    static std::vector<std::string> getNames();
+    static bool isValidName( std::string name );
+};
+
+#endif // SPATIAL_INDEX_H
@@ -2,21 +2,47 @@
 #include <tuple>
 #include <cstdio>
 #include <cmath>
+#include <algorithm>
+#include <sstream>
+#include <cstdint>
 #include <opencv2/opencv.hpp>
 #include <opencv2/features2d.hpp>
 
 #include "VideoFrame.h"
+#include "KeyPointDetector.h"
 #include "InputImage.h"
 #include "Match.h"
+#include "FrameResult.h"
+#include "TranslationVoter.h"
+#include "DistanceKernels.h"
+#include "InvertedGridIndex.h"
+#include "TaskPool.h"
+#include "KeyPointCache.h"
+#include "KdTree.h"
 #include "SurfMatcher.h"
 
 
 SurfMatcher::SurfMatcher(){
-    this->hessianThreshold = 500;
+    this->fastThreshold = 20;
+    this->featureCount = 500;
+    this->scaleLevels = 8;
+    this->detectorName = "orb";
+    this->detector = nullptr;
+    this->indexName = "kdtree";
     this->keypointMatchRadius = 5.0;
+    this->votingMethod = "hough";
     this->videoWidth = 0;
     this->videoHeight = 0;
     this->scaleImages = false;
+    this->hitMasks = false;
+    this->matchedFlags = false;
+    this->translations = nullptr;
+    this->candidateIndex = nullptr;
+    this->candidateRatio = 0.0;
+    this->activeImages = nullptr;
+    this->taskPool = nullptr;
+    this->cache = nullptr;
+    this->images = std::make_shared< std::vector<InputImage> >();
 }
 
 void SurfMatcher::setVideoDimensions( int width, int height){
@@ -28,36 +54,171 @@ void SurfMatcher::doScaleImages(){
     this->scaleImages = true;
 }
 
+void SurfMatcher::doHitMasks(){
+    this->hitMasks = true;
+}
+
+void SurfMatcher::doMatchedFlags(){
+    this->matchedFlags = true;
+}
+
+void SurfMatcher::doCandidateFilter( double ratio ){
+    // call after adding the images, copies of the matcher share the index
+    this->candidateRatio = ratio;
+    this->candidateIndex = std::make_shared<InvertedGridIndex>( this->keypointMatchRadius );
+    for( auto& img : *this->images ){
+        std::vector<cv::KeyPoint> keypoints = img.getKeyPoints();
+        this->candidateIndex->addImage( img.getIndex(), keypoints );
+    }
+    this->candidateIndex->build();
+}
+
+void SurfMatcher::setCache( std::shared_ptr<KeyPointCache> cache ){
+    this->cache = cache;
+}
+
+uint64_t SurfMatcher::getCacheKey( std::vector<unsigned char>& content ){
+    // everything the keypoints depend on besides the file content
+    std::ostringstream params;
+    params << this->detectorName << ":" << this->fastThreshold << ":" << this->featureCount 
+        << ":" << this->scaleLevels;
+    if( this->videoWidth != 0 && this->videoHeight != 0 && this->scaleImages){
+        params << ":" << this->videoWidth << "x" << this->videoHeight;
+    }
+    std::string p = params.str();
+    uint64_t key = KeyPointCache::hash( content.data(), content.size() );
+    return KeyPointCache::hash( p.data(), p.size(), key );
+}
+
+void SurfMatcher::setTaskPool( std::shared_ptr<TaskPool> pool ){
+    this->taskPool = pool;
+}
+
+void SurfMatcher::setActiveImages( std::shared_ptr<ActiveImages> active ){
+    this->activeImages = active;
+}
+
+void SurfMatcher::doSeedTranslations(){
+    // call after adding the images, copies of the matcher share the table
+    this->translations = std::make_shared<TranslationTable>( this->images->size() );
+}
+
+
+void SurfMatcher::createDetector(){
+    this->detector = KeyPointDetector::create( this->detectorName, 
+        this->featureCount, this->fastThreshold, this->scaleLevels );
+}
 
 void SurfMatcher::calcKeyPoints( cv::Mat& mat, std::vector<cv::KeyPoint>& keypoints ){
-    cv::Ptr<cv::FeatureDetector> fdetector = cv::ORB::create();
-    fdetector->detect(mat, keypoints);
+    if( this->detector == nullptr ){
+        this->createDetector();
+    }
+    this->detector->detect(mat, keypoints);
 }
 
-void SurfMatcher::setHessianThreshold( int thres ){
-    this->hessianThreshold = thres;
+void SurfMatcher::setFastThreshold( int thres ){
+    this->fastThreshold = thres;
+    this->detector = nullptr;
+}
+void SurfMatcher::setFeatureCount( int count ){
+    this->featureCount = count;
+    this->detector = nullptr;
+}
+void SurfMatcher::setScaleLevels( int count ){
+    this->scaleLevels = count;
+    this->detector = nullptr;
+}
+void SurfMatcher::setDetectorName( std::string name ){
+    this->detectorName = name;
+    this->detector = nullptr;
+}
+std::string SurfMatcher::getDetectorName(){
+    return this->detectorName;
+}
+void SurfMatcher::setIndexName( std::string name ){
+    this->indexName = name;
+}
+std::string SurfMatcher::getIndexName(){
+    return this->indexName;
+}
+std::shared_ptr< std::vector<InputImage> > SurfMatcher::getImages(){
+    return this->images;
+}
+int SurfMatcher::getImageCount(){
+    return this->images->size();
 }
+
 void SurfMatcher::setKeypointMatchRadius( double r){
     this->keypointMatchRadius = r;
 }
+void SurfMatcher::setVotingMethod( std::string method ){
+    this->votingMethod = method;
+}
 
 void SurfMatcher::addImage( InputImage& img ){
-    std::vector<cv::KeyPoint> keypoints;
-    cv::Mat mat = cv::imread( img.getFileName() );
+    if( this->detector == nullptr ){
+        this->createDetector();
+    }
+    this->prepareImage( img, *this->detector );
+    // makes a copy of the image object
+    this->images->push_back( img );
+}
 
-    // scale image to match video size for better matching
-    if( this->videoWidth != 0 && this->videoHeight != 0 && this->scaleImages){
-        cv::Mat mat2;
-        cv::resize( mat, mat2, cv::Size(this->videoWidth, this->videoHeight),0,0, cv::INTER_CUBIC );
-        this->calcKeyPoints( mat2, keypoints );
-    }else{
-        this->calcKeyPoints( mat, keypoints );
+void SurfMatcher::addImages( std::vector<InputImage>& imgs, TaskPool& pool ){
+    int count = imgs.size();
+    int tasks = std::max( 1, std::min( count, pool.getThreadCount() + 1 ) );
+    pool.run( tasks, [&]( int task ){
+        // detectors keep state, one per task
+        std::shared_ptr<KeyPointDetector> detector = KeyPointDetector::create( this->detectorName, 
+            this->featureCount, this->fastThreshold, this->scaleLevels );
+        for( int i=task; i<count; i+=tasks ){
+            this->prepareImage( imgs[i], *detector );
+        }
+    } );
+    // keep the order of the list
+    for( auto& img : imgs ){
+        this->images->push_back( img );
     }
+}
 
-    img.setKeyPoints( keypoints );
+void SurfMatcher::prepareImage( InputImage& img, KeyPointDetector& detector ){
+    std::vector<cv::KeyPoint> keypoints;
+    std::vector<unsigned char> content;
+    uint64_t key = 0;
+    bool treeOrder = false;
+    bool cached = false;
+    if( this->cache != nullptr && KeyPointCache::readFile( img.getFileName(), content ) ){
+        key = this->getCacheKey( content );
+        cached = this->cache->load( key, keypoints, treeOrder );
+    }
 
-    // makes a copy of the image object
-    this->images.push_back( img );
+    if( ! cached ){
+        // decode the bytes already read for the hash
+        cv::Mat mat = content.empty() ? cv::imread( img.getFileName() ) : cv::imdecode( content, cv::IMREAD_COLOR );
+
+        // scale image to match video size for better matching
+        if( this->videoWidth != 0 && this->videoHeight != 0 && this->scaleImages){
+            cv::Mat mat2;
+            cv::resize( mat, mat2, cv::Size(this->videoWidth, this->videoHeight),0,0, cv::INTER_CUBIC );
+            detector.detect( mat2, keypoints );
+        }else{
+            detector.detect( mat, keypoints );
+        }
+    }
+
+    if( cached && treeOrder && this->indexName == "kdtree" ){
+        img.setDatabase( std::make_shared<KdTree>( keypoints, true ) );
+    }else{
+        img.setKeyPoints( keypoints, this->indexName, this->keypointMatchRadius );
+    }
+    if( ! cached && ! content.empty() ){
+        // store in index order, a kdtree loads without building
+        std::vector<cv::KeyPoint> ordered = img.getKeyPoints();
+        this->cache->store( key, ordered, this->indexName == "kdtree" );
+    }
+    if( this->hitMasks ){
+        img.setHitMask( std::make_shared<HitMask>( keypoints, this->keypointMatchRadius ) );
+    }
 }
 
 double SurfMatcher::getKeyPointDistance( cv::KeyPoint& kp1, cv::KeyPoint& kp2 ){
@@ -68,135 +229,113 @@ double SurfMatcher::getKeyPointDistance( cv::KeyPoint& kp1, cv::KeyPoint& kp2 ){
     return std::sqrt( d );
 }
 
-int SurfMatcher::getBestTranslation( std::vector<cv::KeyPoint>& keypoints, 
-        std::vector<cv::KeyPoint>& nearest, int votes_init, std::vector<int>& best_trans){
-    int N = keypoints.size(); // N=nkeypts -> O(nkeypts^2)
-    std::vector<int> trans = {0,0};
-    int best_votes = votes_init;
-    for( int i=0; i<N; i++ ){
-        trans[0] = nearest[ i ].pt.x - keypoints[ i ].pt.x;
-        trans[1] = nearest[ i ].pt.y - keypoints[ i ].pt.y;
-        int votes = 0;
-        for( int j=0; j<N; j++ ){
-            double d = std::pow( (keypoints[j].pt.x + trans[0]) - nearest[j].pt.x ,2) 
-                     + std::pow( (keypoints[j].pt.y + trans[1]) - nearest[j].pt.y ,2);
-            if( d < 0.0 ){
-                d = -1.0*d;
-            }
-            d = std::sqrt( d );
-            /*int dx = abs( (keypoints[j].pt.x + trans[0]) - nearest[j].pt.x);
-            int dy = abs( (keypoints[j].pt.y + trans[1]) - nearest[j].pt.y);
-            if( dx < d_thres && dy < d_thres ){
-                votes++;
-            }*/
-            if( d < this->keypointMatchRadius ){
-                votes++;
-            }
-        }
-        if( votes > best_votes ){
-            best_votes = votes;
-            best_trans[0] = trans[0];
-            best_trans[1] = trans[1];
+
+int SurfMatcher::estimateTranslation( int imageIndex, MatchScratch& scratch, 
+        int votes_init, std::vector<int>& best_trans ){
+    std::vector<float>& offsetX = scratch.offsetX;
+    std::vector<float>& offsetY = scratch.offsetY;
+    if( this->translations != nullptr ){
+        // try the translation of the last frame first, the crop rarely changes
+        float radius2 = this->keypointMatchRadius * this->keypointMatchRadius;
+        int votes = this->translations->trySeed( imageIndex, offsetX, offsetY, radius2, votes_init, best_trans );
+        if( votes >= 0 ){
+            return votes;
         }
     }
-    return best_votes;
+
+    scratch.voter.setRadius( this->keypointMatchRadius );
+    int votes = scratch.voter.vote( this->votingMethod, offsetX, offsetY, votes_init, best_trans );
+    if( this->translations != nullptr ){
+        this->translations->store( imageIndex, best_trans[0], best_trans[1], votes );
+    }
+    return votes;
 }
 
+std::shared_ptr<FrameResult> SurfMatcher::matchKeyPoints( std::vector<cv::KeyPoint>& keypoints ){
+    int imageCount = this->images->size();
+    std::shared_ptr<FrameResult> result = std::make_shared<FrameResult>( imageCount );
+    result->setKeypointCount( keypoints.size() );
+    if( this->matchedFlags && imageCount > 0 ){
+        result->enableMatchedFlags();
+    }
 
-std::vector< std::shared_ptr<Match> >  SurfMatcher::matchKeyPoints( std::vector<cv::KeyPoint>& keypoints ){
-    int hits;
-    std::vector<cv::KeyPoint> nearest;
-    std::shared_ptr<Match> match;
-    std::vector< std::shared_ptr<Match> > matches;
+    // untranslated hits of every image from the combined index
+    if( this->candidateIndex != nullptr ){
+        this->candidateIndex->countHits( keypoints, this->keypointMatchRadius, 
+            this->candidateHits, this->candidateScratch );
+    }
 
-    int imageIndex = 0;
-    for( auto& img : this->images ){
-        // create a match object per image
-        match = std::make_shared<Match>();
-        matches.push_back( match );
+    int tasks = 1;
+    if( this->taskPool != nullptr ){
+        tasks = std::max( 1, std::min( imageCount, this->taskPool->getThreadCount() + 1 ) );
+    }
+    if( this->scratches.size() < tasks ){
+        this->scratches.resize( tasks );
+    }
 
-        hits = 0;
-        nearest.clear(); // per image
-        for( auto& kp : keypoints ){
-            // per image per keypoint nearest neighbor search
-            cv::KeyPoint neighbor = img.getNearestKeyPoint( kp.pt.x, kp.pt.y );
-            nearest.push_back( neighbor );
-            double dist = SurfMatcher::getKeyPointDistance( kp, neighbor );
-            if( dist < this->keypointMatchRadius ){
-                ++hits;
-            }
+    if( tasks == 1 ){
+        for( int i=0; i<imageCount; i++ ){
+            this->matchImage( i, keypoints, this->candidateHits, this->scratches[0], *result );
         }
-        // get a translation transformation by voting, 
-        // used for matching if the video has been cropped in a different way
-        std::vector<int> best_trans = {0,0};
-        int votes = this->getBestTranslation( keypoints, nearest, hits, best_trans );
-        
-        hits=0;
-        for( int i=0; i<keypoints.size(); i++ ){
-            cv::KeyPoint kp = keypoints[i];
-            //cv::KeyPoint neighbor = nearest[i];
-            // apply transformation
-            kp.pt.x = kp.pt.x + best_trans[0];
-            kp.pt.y = kp.pt.y + best_trans[1];
-            cv::KeyPoint neighbor = img.getNearestKeyPoint( kp.pt.x, kp.pt.y );
-            // match the nearest to the keypoint, discard nearest not near enough to be a hit
-            double dist = SurfMatcher::getKeyPointDistance( kp, neighbor );
-            if( dist < this->keypointMatchRadius ){
-                ++hits;
-                match->addMatchedKeypoint( kp );
+    }else{
+        // fork-join over the images of this frame, interleaved so found images spread evenly
+        this->taskPool->run( tasks, [&]( int task ){
+            for( int i=task; i<imageCount; i+=tasks ){
+                // every task writes the entries of its own images
+                this->matchImage( i, keypoints, this->candidateHits, this->scratches[task], *result );
             }
-        }
-        
-        match->setImageIndex( imageIndex );
-        match->setKeypointMatchCount( hits );
-        match->setImageKeypointCount( img.getKeypointCount() );
-        imageIndex++;
+        } );
     }
-    return matches;
+    return result;
 }
 
-void SurfMatcher::updateBestMatch( std::shared_ptr<Match> match ){
-    InputImage& img = this->images.at( match->getImageIndex() );
-    Match currentBest = img.getBestMatch();
-    if( match->getMatchRatio() > currentBest.getMatchRatio() 
-            && match->getSnr() > currentBest.getSnr() ){
-        img.setBestMatch( *match );
-    }
-}
+void SurfMatcher::matchImage( int imageIndex, std::vector<cv::KeyPoint>& keypoints, 
+        std::vector<int>& candidateHits, MatchScratch& scratch, FrameResult& result ){
+    InputImage& img = (*this->images)[imageIndex];
+    float radius2 = this->keypointMatchRadius * this->keypointMatchRadius;
+    result.setImageKeypointCount( imageIndex, img.getKeypointCount() );
 
-void SurfMatcher::updateBestMatches( std::vector< std::shared_ptr<Match> > matches ){
-    for( auto& match : matches ){
-        this->updateBestMatch( match );
+    if( this->activeImages != nullptr && ! this->activeImages->isActive( imageIndex ) ){
+        // already found, not matched to this frame
+        result.setSkipped( imageIndex );
+        return;
+    }
+    if( this->candidateIndex != nullptr 
+            && candidateHits[imageIndex] < this->candidateRatio * img.getKeypointCount() ){
+        // too few hits to be worth the search and voting, keep the untranslated count
+        result.setKeypointMatchCount( imageIndex, candidateHits[imageIndex] );
+        return;
     }
-}
-
-void SurfMatcher::updateMatchAverages( std::shared_ptr<Match> match ){
-    InputImage& img = this->images.at( match->getImageIndex() );
-    long missCount = match->getKeypointCount() - match->getKeypointMatchCount();
-    img.updateAverages( match->getKeypointMatchCount(), missCount );
-}
-long SurfMatcher::getTotalKeypointMiss( std::shared_ptr<Match> match ){
-    InputImage& img = this->images.at( match->getImageIndex() );
-    return img.getTotalKeypointMiss();
-}
-long SurfMatcher::getTotalKeypointHit( std::shared_ptr<Match> match ){
-    InputImage& img = this->images.at( match->getImageIndex() );
-    return img.getTotalKeypointHit();
-}
 
-bool SurfMatcher::isImageFound( std::shared_ptr<Match> match ){
-    InputImage& img = this->images.at( match->getImageIndex() );
-    return img.isFound();
-}
-bool SurfMatcher::isFullMatch( std::shared_ptr<Match> match ){
-    InputImage& img = this->images.at( match->getImageIndex() );
-    return img.isFullMatch( match );
-}
+    scratch.nearest.clear();
+    for( auto& kp : keypoints ){
+        // per image per keypoint nearest neighbor search
+        scratch.nearest.push_back( img.getNearestKeyPoint( kp.pt.x, kp.pt.y ) );
+    }
+    TranslationVoter::getOffsets( keypoints, scratch.nearest, scratch.offsetX, scratch.offsetY );
+    // hits without translation, the pairs closer than the radius
+    int hits = DistanceKernels::countWithin( scratch.offsetX.data(), scratch.offsetY.data(), 
+        scratch.offsetX.size(), 0, 0, radius2 );
 
+    // get a translation transformation by voting, 
+    // used for matching if the video has been cropped in a different way
+    std::vector<int> best_trans = {0,0};
+    int votes = this->estimateTranslation( imageIndex, scratch, hits, best_trans );
 
-void SurfMatcher::dumpBestMatch(){
-    for( auto& img : this->images ){
-        img.dumpBestMatch();
+    hits=0;
+    for( int i=0; i<keypoints.size(); i++ ){
+        cv::KeyPoint kp = keypoints[i];
+        // apply transformation
+        kp.pt.x = kp.pt.x + best_trans[0];
+        kp.pt.y = kp.pt.y + best_trans[1];
+        // a hit only needs any image keypoint inside the radius, not the nearest one
+        if( img.hasNeighborWithin( kp.pt.x, kp.pt.y, this->keypointMatchRadius ) ){
+            ++hits;
+            if( imageIndex == 0 && result.hasMatchedFlags() ){
+                result.setMatched( i );
+            }
+        }
     }
+    result.setKeypointMatchCount( imageIndex, hits );
 }
 
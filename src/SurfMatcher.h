@@ -7,8 +7,15 @@
 #include <opencv2/features2d.hpp>
 
 #include "VideoFrame.h"
+#include "KeyPointDetector.h"
 #include "InputImage.h"
 #include "Match.h"
+#include "FrameResult.h"
+#include "TranslationVoter.h"
+#include "InvertedGridIndex.h"
+#include "ActiveImages.h"
+#include "TaskPool.h"
+#include "KeyPointCache.h"
 
 class SurfMatcher{
 
@@ -16,38 +23,88 @@ public:
     SurfMatcher();
     //~SurfMatcher();
 
-    void setHessianThreshold( int thres );
+    void setFastThreshold( int thres );
+    void setFeatureCount( int count );
+    void setScaleLevels( int count );
+    void setDetectorName( std::string name );
+    std::string getDetectorName();
+    void setIndexName( std::string name );
+    std::string getIndexName();
+    int getImageCount();
+    std::shared_ptr< std::vector<InputImage> > getImages();
     void setKeypointMatchRadius( double r);
+    void setVotingMethod( std::string method );
     void setVideoDimensions( int width, int height);
     void doScaleImages();
+    void doHitMasks();
+    void doSeedTranslations();
+    void doCandidateFilter( double ratio );
+    void doMatchedFlags();
+    void setActiveImages( std::shared_ptr<ActiveImages> active );
+    void setTaskPool( std::shared_ptr<TaskPool> pool );
+    void setCache( std::shared_ptr<KeyPointCache> cache );
 
     void addImage( InputImage& img );
+    // prepares the images on the pool, same result as adding them one by one
+    void addImages( std::vector<InputImage>& imgs, TaskPool& pool );
 
+    void createDetector();
     void calcKeyPoints( cv::Mat& mat, std::vector<cv::KeyPoint>& keypoints );
-    std::vector< std::shared_ptr<Match> > matchKeyPoints( std::vector<cv::KeyPoint>& keypoints );
-    void updateBestMatches( std::vector< std::shared_ptr<Match> > matches );
-    void updateBestMatch( std::shared_ptr<Match> match );
-    void dumpBestMatch();
+    std::shared_ptr<FrameResult> matchKeyPoints( std::vector<cv::KeyPoint>& keypoints );
 
     static double getKeyPointDistance( cv::KeyPoint& kp1, cv::KeyPoint& kp2 );
-    int getBestTranslation( std::vector<cv::KeyPoint>& keypoints, 
-            std::vector<cv::KeyPoint>& nearest, int votes_init, std::vector<int>& best_trans);
 
-    void updateMatchAverages( std::shared_ptr<Match> match );
-    long getTotalKeypointMiss( std::shared_ptr<Match> match );
-    long getTotalKeypointHit( std::shared_ptr<Match> match );
 
-    bool isImageFound( std::shared_ptr<Match> match );
-    bool isFullMatch( std::shared_ptr<Match> match );
+private:
+    // buffers of one matching task, reused between frames
+    struct MatchScratch{
+        std::vector<cv::KeyPoint> nearest;
+        std::vector<float> offsetX; // pair offsets nearest - keypoint
+        std::vector<float> offsetY;
+        TranslationVoter voter;
+    };
 
+    void prepareImage( InputImage& img, KeyPointDetector& detector );
+    uint64_t getCacheKey( std::vector<unsigned char>& content );
+    void matchImage( int imageIndex, std::vector<cv::KeyPoint>& keypoints, 
+            std::vector<int>& candidateHits, MatchScratch& scratch, FrameResult& result );
+    int estimateTranslation( int imageIndex, MatchScratch& scratch, 
+            int votes_init, std::vector<int>& best_trans );
 
-private:
-    int hessianThreshold;
+    int fastThreshold;
+    int featureCount;
+    int scaleLevels;
+    std::string detectorName;
+    // created once and reused for every frame. Copies of the matcher share it 
+    // until they call createDetector(), as every worker thread does.
+    std::shared_ptr<KeyPointDetector> detector;
+    std::string indexName;
     double keypointMatchRadius;
-    std::vector< InputImage > images;
+    std::string votingMethod;
+    // one per task, every thread has its own copy of the matcher
+    std::vector<MatchScratch> scratches;
+    // last translation per image, shared by all threads, null when disabled
+    std::shared_ptr<TranslationTable> translations;
+    // hits of all images in one pass, images below the ratio skip the voting
+    std::shared_ptr<InvertedGridIndex> candidateIndex;
+    double candidateRatio;
+    // buffers of the candidate filter, reused between frames
+    std::vector<int> candidateHits;
+    std::vector<int> candidateScratch;
+    // images still searched for, null matches all images
+    std::shared_ptr<ActiveImages> activeImages;
+    // splits the images of one frame into tasks, shared by all threads, null runs serially
+    std::shared_ptr<TaskPool> taskPool;
+    // keypoints of unchanged images from earlier runs, null detects every time
+    std::shared_ptr<KeyPointCache> cache;
+    // read only once added, copies of the matcher share them
+    std::shared_ptr< std::vector<InputImage> > images;
     int videoWidth;
     int videoHeight;
     bool scaleImages;
+    bool hitMasks;
+    // flag the matched frame keypoints of the first image, only the overlay needs them
+    bool matchedFlags;
 };
 
 #endif // SURF_MATCHER_H
\ No newline at end of file
@@ -0,0 +1,96 @@
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+
+#include "TaskPool.h"
+
+
+TaskPool::TaskPool( int threads ){
+    this->stop = false;
+    for( int i=0; i<threads; i++ ){
+        this->threads.push_back( std::thread( &TaskPool::work, this ) );
+    }
+}
+
+TaskPool::~TaskPool(){
+    std::unique_lock<std::mutex> lock( this->mutex );
+    this->stop = true;
+    lock.unlock();
+    this->condJobs.notify_all();
+    for( auto& t : this->threads ){
+        t.join();
+    }
+}
+
+int TaskPool::getThreadCount(){
+    return this->threads.size();
+}
+
+void TaskPool::run( int count, const std::function<void(int)>& task ){
+    if( count <= 0 ){
+        return;
+    }
+    Batch batch;
+    batch.task = &task;
+    batch.remaining = count;
+
+    std::unique_lock<std::mutex> lock( this->mutex );
+    // the calling thread takes task 0 itself
+    for( int i=1; i<count; i++ ){
+        this->jobs.push_back( { &batch, i } );
+    }
+    this->condJobs.notify_all();
+    this->execute( { &batch, 0 }, lock );
+
+    while( batch.remaining > 0 ){
+        if( ! this->jobs.empty() ){
+            // help instead of waiting, possibly with the batch of another caller
+            Job job = this->jobs.front();
+            this->jobs.pop_front();
+            this->execute( job, lock );
+        }else{
+            this->condDone.wait( lock );
+        }
+    }
+    lock.unlock();
+    if( batch.error ){
+        std::rethrow_exception( batch.error );
+    }
+}
+
+void TaskPool::work(){
+    std::unique_lock<std::mutex> lock( this->mutex );
+    while( true ){
+        this->condJobs.wait( lock, [this]{ return this->stop || ! this->jobs.empty(); } );
+        if( this->jobs.empty() ){
+            // stopping
+            break;
+        }
+        Job job = this->jobs.front();
+        this->jobs.pop_front();
+        this->execute( job, lock );
+    }
+}
+
+void TaskPool::execute( Job job, std::unique_lock<std::mutex>& lock ){
+    // called and returns with the lock held, the task itself runs unlocked
+    lock.unlock();
+    std::exception_ptr error;
+    try{
+        (*job.batch->task)( job.index );
+    }catch( ... ){
+        error = std::current_exception();
+    }
+    lock.lock();
+    if( error && ! job.batch->error ){
+        job.batch->error = error;
+    }
+    job.batch->remaining--;
+    if( job.batch->remaining == 0 ){
+        this->condDone.notify_all();
+    }
+}
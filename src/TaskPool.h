@@ -0,0 +1,49 @@
+#ifndef TASK_POOL_H
+#define TASK_POOL_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+
+/*
+ * Fixed set of threads running fork-join batches. run() may be called from
+ * several threads at once, every caller helps with the queued tasks until its
+ * own batch is done.
+ */
+class TaskPool{
+
+public:
+    TaskPool( int threads );
+    ~TaskPool();
+
+    // runs task(0) .. task(count-1) and returns when all of them are done
+    void run( int count, const std::function<void(int)>& task );
+    int getThreadCount();
+
+private:
+    struct Batch{
+        const std::function<void(int)>* task;
+        int remaining;
+        std::exception_ptr error;
+    };
+    struct Job{
+        Batch* batch;
+        int index;
+    };
+
+    void work();
+    void execute( Job job, std::unique_lock<std::mutex>& lock );
+
+    std::vector<std::thread> threads;
+    std::deque<Job> jobs;
+    std::mutex mutex;
+    std::condition_variable condJobs; // jobs queued or stopping
+    std::condition_variable condDone; // a job of some batch finished
+    bool stop;
+};
+
+#endif // TASK_POOL_H
@@ -0,0 +1,245 @@
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+#include <opencv2/opencv.hpp>
+
+#include "TranslationVoter.h"
+#include "DistanceKernels.h"
+
+
+TranslationVoter::TranslationVoter(){
+    this->radius = 5.0;
+}
+
+void TranslationVoter::setRadius( double r ){
+    this->radius = r;
+}
+double TranslationVoter::getRadius(){
+    return this->radius;
+}
+
+std::vector<std::string> TranslationVoter::getMethods(){
+    return { "hough", "pairwise" };
+}
+
+bool TranslationVoter::isValidMethod( std::string name ){
+    for( auto& n : TranslationVoter::getMethods() ){
+        if( n == name ){
+            return true;
+        }
+    }
+    return false;
+}
+
+int TranslationVoter::vote( std::string method, std::vector<float>& offsetX, std::vector<float>& offsetY, 
+        int votes_init, std::vector<int>& best_trans ){
+    if( method == "hough" ){
+        return this->voteHough( offsetX, offsetY, votes_init, best_trans );
+    }else if( method == "pairwise" ){
+        return this->votePairwise( offsetX, offsetY, votes_init, best_trans );
+    }
+    throw std::invalid_argument( "unknown voting method " + method );
+}
+
+void TranslationVoter::getOffsets( std::vector<cv::KeyPoint>& keypoints, std::vector<cv::KeyPoint>& nearest, 
+        std::vector<float>& offsetX, std::vector<float>& offsetY ){
+    offsetX.resize( keypoints.size() );
+    offsetY.resize( keypoints.size() );
+    for( int i=0; i<keypoints.size(); i++ ){
+        offsetX[i] = nearest[i].pt.x - keypoints[i].pt.x;
+        offsetY[i] = nearest[i].pt.y - keypoints[i].pt.y;
+    }
+}
+
+int TranslationVoter::votePairwise( std::vector<float>& offsetX, std::vector<float>& offsetY, 
+        int votes_init, std::vector<int>& best_trans ){
+    int N = offsetX.size(); // N=nkeypts -> O(nkeypts^2)
+    float radius2 = this->radius * this->radius;
+    int best_votes = votes_init;
+    for( int i=0; i<N; i++ ){
+        int tx = offsetX[i];
+        int ty = offsetY[i];
+        // pair j votes for the translation if its offset is within the radius
+        int votes = DistanceKernels::countWithin( offsetX.data(), offsetY.data(), N, tx, ty, radius2 );
+        if( votes > best_votes ){
+            best_votes = votes;
+            best_trans[0] = tx;
+            best_trans[1] = ty;
+        }
+    }
+    return best_votes;
+}
+
+int TranslationVoter::voteHough( std::vector<float>& offsetX, std::vector<float>& offsetY, 
+        int votes_init, std::vector<int>& best_trans ){
+    int N = offsetX.size();
+    if( !( this->radius > 0.0 ) ){
+        // nothing can be within a zero radius
+        return votes_init;
+    }
+
+    // accumulator: the offsets sorted by their cell
+    this->bins.clear();
+    for( int i=0; i<N; i++ ){
+        int64_t key = this->binKey( (int64_t) std::floor( offsetX[i] / this->radius ), 
+            (int64_t) std::floor( offsetY[i] / this->radius ) );
+        this->bins.push_back( std::make_pair( key, i ) );
+    }
+    std::sort( this->bins.begin(), this->bins.end() );
+    this->binKeys.resize( N );
+    this->binX.resize( N );
+    this->binY.resize( N );
+    for( int k=0; k<N; k++ ){
+        this->binKeys[k] = this->bins[k].first;
+        this->binX[k] = offsetX[ this->bins[k].second ];
+        this->binY[k] = offsetY[ this->bins[k].second ];
+    }
+
+    // a pair votes for a candidate only if its offset is within the radius, so within 
+    // the 3x3 cells around the candidate. Their total bounds the votes of the candidate.
+    this->candidates.clear();
+    for( int i=0; i<N; i++ ){
+        Candidate c;
+        c.tx = offsetX[i];
+        c.ty = offsetY[i];
+        c.index = i;
+        c.bound = 0;
+        int64_t cx = (int64_t) std::floor( c.tx / this->radius );
+        int64_t cy = (int64_t) std::floor( c.ty / this->radius );
+        for( int64_t y = cy-1; y <= cy+1; y++ ){
+            c.bound += this->binCount( this->binKey( cx-1, y ), this->binKey( cx+2, y ) );
+        }
+        this->candidates.push_back( c );
+    }
+    // highest peaks first, equal translations next to each other with the first pair leading
+    std::sort( this->candidates.begin(), this->candidates.end(), 
+        []( const Candidate& a, const Candidate& b ){
+            if( a.bound != b.bound ) return a.bound > b.bound;
+            if( a.tx != b.tx ) return a.tx < b.tx;
+            if( a.ty != b.ty ) return a.ty < b.ty;
+            return a.index < b.index;
+        } );
+
+    int best_votes = votes_init;
+    int best_index = -1;
+    for( int k=0; k<N; k++ ){
+        Candidate& c = this->candidates[k];
+        if( c.bound < best_votes ){
+            // ordered by bound: no later candidate can win
+            break;
+        }
+        if( c.bound == best_votes && ( best_index < 0 || best_index < c.index ) ){
+            // could only tie, and ties go to the first pair
+            continue;
+        }
+        if( k > 0 && c.tx == this->candidates[k-1].tx && c.ty == this->candidates[k-1].ty ){
+            // already scored with a lower pair index
+            continue;
+        }
+        int votes = this->countVotes( c.tx, c.ty );
+        if( votes > best_votes || ( votes == best_votes && best_index >= 0 && c.index < best_index ) ){
+            best_votes = votes;
+            best_index = c.index;
+            best_trans[0] = c.tx;
+            best_trans[1] = c.ty;
+        }
+    }
+    return best_votes;
+}
+
+/* Helpers */
+
+int64_t TranslationVoter::binKey( int64_t x, int64_t y ){
+    // row major, the cells of one row are adjacent when sorted
+    return y * ((int64_t) 1 << 32) + x;
+}
+
+int TranslationVoter::binCount( int64_t first, int64_t last ){
+    // number of offsets in the cells [first,last)
+    auto lower = std::lower_bound( this->binKeys.begin(), this->binKeys.end(), first );
+    auto upper = std::lower_bound( lower, this->binKeys.end(), last );
+    return upper - lower;
+}
+
+int TranslationVoter::countVotes( int tx, int ty ){
+    float radius2 = this->radius * this->radius;
+    int64_t cx = (int64_t) std::floor( tx / this->radius );
+    int64_t cy = (int64_t) std::floor( ty / this->radius );
+    int votes = 0;
+    for( int64_t y = cy-1; y <= cy+1; y++ ){
+        // the three cells of a row are adjacent in the sorted accumulator
+        auto first = std::lower_bound( this->binKeys.begin(), this->binKeys.end(), this->binKey( cx-1, y ) );
+        auto last = std::lower_bound( first, this->binKeys.end(), this->binKey( cx+2, y ) );
+        int begin = first - this->binKeys.begin();
+        int end = last - this->binKeys.begin();
+        votes += DistanceKernels::countWithin( this->binX.data() + begin, this->binY.data() + begin, 
+            end - begin, tx, ty, radius2 );
+    }
+    return votes;
+}
+
+
+/*
+
+    Translation Table
+
+ */
+
+static const uint64_t emptyEntry = ~(uint64_t) 0;
+
+TranslationTable::TranslationTable( int size ) : entries( size ){
+    for( auto& e : this->entries ){
+        e.store( emptyEntry, std::memory_order_relaxed );
+    }
+}
+
+bool TranslationTable::load( int index, int& tx, int& ty, int& votes ){
+    uint64_t e = this->entries[index].load( std::memory_order_relaxed );
+    votes = (int32_t) (uint32_t) (e >> 32);
+    if( votes < 0 ){
+        return false;
+    }
+    tx = (int16_t) (uint16_t) e;
+    ty = (int16_t) (uint16_t) (e >> 16);
+    return true;
+}
+
+void TranslationTable::store( int index, int tx, int ty, int votes ){
+    if( tx < INT16_MIN || tx > INT16_MAX || ty < INT16_MIN || ty > INT16_MAX ){
+        // not a crop offset of any real video
+        return;
+    }
+    uint64_t e = (uint64_t) (uint16_t) tx 
+        | (uint64_t) (uint16_t) ty << 16 
+        | (uint64_t) (uint32_t) votes << 32;
+    this->entries[index].store( e, std::memory_order_relaxed );
+}
+
+int TranslationTable::size(){
+    return this->entries.size();
+}
+
+int TranslationTable::trySeed( int index, std::vector<float>& offsetX, std::vector<float>& offsetY, 
+        float radius2, int votes_init, std::vector<int>& best_trans ){
+    int tx, ty, lastVotes;
+    if( ! this->load( index, tx, ty, lastVotes ) ){
+        return -1;
+    }
+    int votes = DistanceKernels::countWithin( offsetX.data(), offsetY.data(), offsetX.size(), tx, ty, radius2 );
+    if( votes < lastVotes * TranslationTable::seedKeepRatio 
+            || votes < offsetX.size() * TranslationTable::seedMinRatio ){
+        return -1;
+    }
+    if( votes > votes_init ){
+        best_trans[0] = tx;
+        best_trans[1] = ty;
+    }else{
+        votes = votes_init;
+    }
+    // the next frame is seeded with the translation this one used
+    this->store( index, best_trans[0], best_trans[1], votes );
+    return votes;
+}
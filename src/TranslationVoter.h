@@ -0,0 +1,91 @@
+#ifndef TRANSLATION_VOTER_H
+#define TRANSLATION_VOTER_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <atomic>
+#include <opencv2/opencv.hpp>
+
+/*
+ * Finds the translation between the frame keypoints and their nearest image
+ * keypoints that brings most pairs within the match radius. The pairs are given
+ * as their offsets nearest - keypoint. Candidates are the (truncated) offsets
+ * themselves, a candidate only wins with more votes than votes_init, ties go 
+ * to the first pair.
+ */
+class TranslationVoter{
+
+public:
+    TranslationVoter();
+
+    void setRadius( double r );
+    double getRadius();
+
+    int vote( std::string method, std::vector<float>& offsetX, std::vector<float>& offsetY, 
+            int votes_init, std::vector<int>& best_trans );
+
+    // scores every candidate against every pair, O(N^2)
+    int votePairwise( std::vector<float>& offsetX, std::vector<float>& offsetY, 
+            int votes_init, std::vector<int>& best_trans );
+    // bins the offsets into radius sized cells and only scores the candidates
+    // whose 3x3 cell neighborhood could still beat the best, same result
+    int voteHough( std::vector<float>& offsetX, std::vector<float>& offsetY, 
+            int votes_init, std::vector<int>& best_trans );
+
+    static void getOffsets( std::vector<cv::KeyPoint>& keypoints, std::vector<cv::KeyPoint>& nearest, 
+            std::vector<float>& offsetX, std::vector<float>& offsetY );
+    static std::vector<std::string> getMethods();
+    static bool isValidMethod( std::string name );
+
+private:
+    struct Candidate{
+        int bound;
+        int tx;
+        int ty;
+        int index;
+    };
+
+    int64_t binKey( int64_t x, int64_t y );
+    int binCount( int64_t first, int64_t last );
+    int countVotes( int tx, int ty );
+
+    double radius;
+    // scratch reused between calls
+    std::vector< std::pair<int64_t,int> > bins; // (bin key, pair index) sorted by key
+    std::vector<int64_t> binKeys; // keys of the sorted offsets
+    std::vector<float> binX; // offsets in bin order
+    std::vector<float> binY;
+    std::vector<Candidate> candidates;
+};
+
+/*
+ * Last translation and its votes per image, shared by all match workers.
+ * Each entry is one packed atomic word, readers never see a torn update.
+ */
+class TranslationTable{
+
+public:
+    TranslationTable( int size );
+
+    bool load( int index, int& tx, int& ty, int& votes );
+    void store( int index, int tx, int ty, int votes );
+    int size();
+
+    // scores the stored translation of the image against the pair offsets. If it is kept
+    // returns the votes and the translation used (best_trans stays if it does not beat 
+    // votes_init) and stores both, otherwise returns -1 and the full voting has to run.
+    int trySeed( int index, std::vector<float>& offsetX, std::vector<float>& offsetY, 
+            float radius2, int votes_init, std::vector<int>& best_trans );
+
+    // a seed is kept if it scores this fraction of the last frame's votes
+    // and this fraction of the frame keypoints
+    static constexpr double seedKeepRatio = 0.9;
+    static constexpr double seedMinRatio = 0.2;
+
+private:
+    // 16 bit tx, 16 bit ty, 32 bit votes. votes -1 marks an empty entry
+    std::vector< std::atomic<uint64_t> > entries;
+};
+
+#endif // TRANSLATION_VOTER_H
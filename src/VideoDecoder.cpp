@@ -1,5 +1,15 @@
 #include <cstdio>
+#include <cmath>
+#include <cerrno>
 #include <memory>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 extern "C" {
     #include <libavcodec/avcodec.h>
@@ -13,6 +23,94 @@ extern "C" {
 #include "VideoDecoder.h"
 #include "VideoFrame.h"
 
+/*
+
+    Packet Queue
+
+ */
+
+PacketQueue::PacketQueue(){
+    this->maxLength = 64;
+    this->error = 0;
+    this->aborted = false;
+}
+
+PacketQueue::~PacketQueue(){
+    this->reset();
+}
+
+void PacketQueue::setMaxLength( size_t len ){
+    this->maxLength = len;
+}
+
+bool PacketQueue::push( AVPacket* packet ){
+    std::unique_lock<std::mutex> mlock( this->mutex );
+    while( this->items.size() >= this->maxLength && ! this->aborted ){
+        this->condPush.wait( mlock );
+    }
+    if( this->aborted ){
+        return false;
+    }
+    // take over the reference of the packet
+    AVPacket* item = av_packet_alloc();
+    av_packet_move_ref( item, packet );
+    this->items.push_back( item );
+    mlock.unlock();
+    this->condPop.notify_one();
+    return true;
+}
+
+int PacketQueue::pop( AVPacket* packet ){
+    std::unique_lock<std::mutex> mlock( this->mutex );
+    while( this->items.empty() && this->error == 0 && ! this->aborted ){
+        this->condPop.wait( mlock );
+    }
+    if( this->items.empty() ){
+        // the demuxer has finished
+        return ( this->error != 0 ) ? this->error : AVERROR_EOF;
+    }
+    AVPacket* item = this->items.front();
+    this->items.pop_front();
+    mlock.unlock();
+    this->condPush.notify_one();
+
+    av_packet_move_ref( packet, item );
+    av_packet_free( &item );
+    return 0;
+}
+
+void PacketQueue::setError( int err ){
+    std::unique_lock<std::mutex> mlock( this->mutex );
+    this->error = err;
+    mlock.unlock();
+    this->condPop.notify_all();
+}
+
+void PacketQueue::abort(){
+    std::unique_lock<std::mutex> mlock( this->mutex );
+    this->aborted = true;
+    mlock.unlock();
+    this->condPush.notify_all();
+    this->condPop.notify_all();
+}
+
+void PacketQueue::reset(){
+    std::unique_lock<std::mutex> mlock( this->mutex );
+    for( auto item : this->items ){
+        av_packet_free( &item );
+    }
+    this->items.clear();
+    this->error = 0;
+    this->aborted = false;
+}
+
+
+/*
+
+    Video Decoder
+
+ */
+
 VideoDecoder::VideoDecoder(){
     av_register_all();
     this->has_packet = false;
@@ -22,12 +120,27 @@ VideoDecoder::VideoDecoder(){
     this->codec_par = NULL;
     this->videoStreamIndex = -1;
     this->decoderThreads = -1;
+    this->keyframesOnly = false;
+    this->resyncIndex = false;
+    this->readAhead = 0;
+    this->ioBufferSize = 0;
+    this->ioFd = -1;
+    this->avio_ctx = NULL;
 }
 
 VideoDecoder::~VideoDecoder(){
+    this->stopDemuxer();
     avcodec_close( this->codec_ctx );
     avformat_close_input( &(this->format_ctx) );
     avformat_free_context( this->format_ctx );
+    if( this->avio_ctx != NULL ){
+        // custom IO is not freed by libavformat
+        av_freep( &(this->avio_ctx->buffer) );
+        av_freep( &(this->avio_ctx) );
+    }
+    if( this->ioFd >= 0 ){
+        close( this->ioFd );
+    }
 }
 
 void VideoDecoder::setDecoderThreads( int num ){
@@ -37,6 +150,20 @@ void VideoDecoder::setDecoderThreads( int num ){
     }
 }
 
+void VideoDecoder::setKeyframesOnly( bool enable ){
+    this->keyframesOnly = enable;
+    if( this->codec_ctx != NULL ){
+        this->codec_ctx->skip_frame = enable ? AVDISCARD_NONKEY : AVDISCARD_DEFAULT;
+    }
+}
+
+void VideoDecoder::setReadAhead( int packets ){
+    this->readAhead = packets;
+}
+
+void VideoDecoder::setIoBufferSize( int bytes ){
+    this->ioBufferSize = bytes;
+}
 
 int VideoDecoder::getWidth(){
     return this->width;
@@ -55,9 +182,70 @@ double VideoDecoder::getFrameRate(){
     return rate.num*1.0 / rate.den;
 }
 
+void VideoDecoder::openCustomIo( std::string fileName ){
+    struct stat st;
+    if( stat( fileName.c_str(), &st ) != 0 || ! S_ISREG( st.st_mode ) ){
+        // leave pipes, devices and URLs to libavformat
+        return;
+    }
+    this->ioFd = open( fileName.c_str(), O_RDONLY );
+    if( this->ioFd < 0 ){
+        throw VideoDecoderError( "failed to open input video file" );
+    }
+    // we read the file front to back, let the kernel read ahead aggressively
+    posix_fadvise( this->ioFd, 0, 0, POSIX_FADV_SEQUENTIAL );
+
+    unsigned char* buffer = (unsigned char*) av_malloc( this->ioBufferSize );
+    if( buffer == NULL ){
+        throw VideoDecoderError( "failed to allocate IO buffer" );
+    }
+    this->avio_ctx = avio_alloc_context( buffer, this->ioBufferSize, 0, this, 
+        VideoDecoder::ioRead, NULL, VideoDecoder::ioSeek );
+    if( this->avio_ctx == NULL ){
+        av_free( buffer );
+        throw VideoDecoderError( "failed to allocate AVIOContext" );
+    }
+    this->format_ctx->pb = this->avio_ctx;
+    this->format_ctx->flags |= AVFMT_FLAG_CUSTOM_IO;
+}
+
+int VideoDecoder::ioRead( void* opaque, uint8_t* buf, int size ){
+    VideoDecoder* self = static_cast<VideoDecoder*>( opaque );
+    ssize_t n = read( self->ioFd, buf, size );
+    if( n < 0 ){
+        return AVERROR( errno );
+    }
+    if( n == 0 ){
+        return AVERROR_EOF;
+    }
+    // ask for the next few buffers while we are decoding this one
+    off_t pos = lseek( self->ioFd, 0, SEEK_CUR );
+    posix_fadvise( self->ioFd, pos, 4 * (off_t) self->ioBufferSize, POSIX_FADV_WILLNEED );
+    return n;
+}
+
+int64_t VideoDecoder::ioSeek( void* opaque, int64_t offset, int whence ){
+    VideoDecoder* self = static_cast<VideoDecoder*>( opaque );
+    if( whence == AVSEEK_SIZE ){
+        struct stat st;
+        if( fstat( self->ioFd, &st ) != 0 ){
+            return AVERROR( errno );
+        }
+        return st.st_size;
+    }
+    off_t pos = lseek( self->ioFd, offset, whence & ~AVSEEK_FORCE );
+    if( pos < 0 ){
+        return AVERROR( errno );
+    }
+    return pos;
+}
+
 void VideoDecoder::openFile( std::string fileName ){
     int ret;
     AVCodec *codec;
+    if( this->ioBufferSize > 0 ){
+        this->openCustomIo( fileName );
+    }
     if( (ret = avformat_open_input(&(this->format_ctx), fileName.c_str(), NULL, NULL)) < 0 ){
         throw VideoDecoderError( "failed to open input video file" );
     }
@@ -69,7 +257,14 @@ void VideoDecoder::openFile( std::string fileName ){
     if( ret < 0) {
         throw VideoDecoderError( "no video stream found" );
     }
-    this->codec_par = this->format_ctx->streams[ret]->codecpar;
+    int streamIndex = ret;
+    this->codec_par = this->format_ctx->streams[streamIndex]->codecpar;
+    for( unsigned int i=0; i < this->format_ctx->nb_streams; i++ ){
+        if( (int) i != streamIndex ){
+            // audio, subtitles, ... are dropped by the demuxer without parsing
+            this->format_ctx->streams[i]->discard = AVDISCARD_ALL;
+        }
+    }
 
     this->codec_ctx = avcodec_alloc_context3(codec);
     if( !this->codec_ctx ){
@@ -83,6 +278,10 @@ void VideoDecoder::openFile( std::string fileName ){
     if( this->decoderThreads > 0 ){
         this->codec_ctx->thread_count = this->decoderThreads;
     }
+    if( this->keyframesOnly ){
+        // let the decoder drop everything but keyframes
+        this->codec_ctx->skip_frame = AVDISCARD_NONKEY;
+    }
 
     this->width = this->codec_par->width;
     this->height = this->codec_par->height;
@@ -91,7 +290,115 @@ void VideoDecoder::openFile( std::string fileName ){
     if( (ret = avcodec_open2(this->codec_ctx, codec, NULL)) < 0) {
         throw VideoDecoderError( "failed to open the video decoder" );
     }
-    this->videoStreamIndex = ret;
+    this->videoStreamIndex = streamIndex;
+    this->startDemuxer();
+}
+
+void VideoDecoder::startDemuxer(){
+    if( this->readAhead <= 0 || this->demuxThread.joinable() ){
+        return;
+    }
+    this->packetQueue.reset();
+    this->packetQueue.setMaxLength( this->readAhead );
+    this->demuxThread = std::thread( &VideoDecoder::demux, this );
+}
+
+void VideoDecoder::stopDemuxer(){
+    if( ! this->demuxThread.joinable() ){
+        return;
+    }
+    this->packetQueue.abort();
+    this->demuxThread.join();
+    this->packetQueue.reset();
+}
+
+void VideoDecoder::demux(){
+    // runs in demuxThread, the only user of format_ctx while running
+    AVPacket pkt;
+    av_init_packet( &pkt );
+    pkt.data = NULL;
+    pkt.size = 0;
+    while( 1 ){
+        int ret = av_read_frame( this->format_ctx, &pkt );
+        if( ret < 0 ){
+            this->packetQueue.setError( ret );
+            return;
+        }
+        if( pkt.stream_index != this->videoStreamIndex 
+                || ( this->keyframesOnly && !(pkt.flags & AV_PKT_FLAG_KEY) ) ){
+            av_packet_unref( &pkt );
+            continue;
+        }
+        if( ! this->packetQueue.push( &pkt ) ){
+            // aborted
+            av_packet_unref( &pkt );
+            return;
+        }
+    }
+}
+
+int VideoDecoder::readPacket( AVPacket* pkt ){
+    if( this->demuxThread.joinable() ){
+        return this->packetQueue.pop( pkt );
+    }
+    return av_read_frame( this->format_ctx, pkt );
+}
+
+long int VideoDecoder::ptsToFrameIndex( int64_t pts ){
+    AVStream* stream = this->format_ctx->streams[this->videoStreamIndex];
+    if( stream->start_time != AV_NOPTS_VALUE ){
+        pts = pts - stream->start_time;
+    }
+    return std::llround( av_q2d( stream->time_base ) * pts * this->getFrameRate() );
+}
+
+void VideoDecoder::seekFrame( long int frameIndex ){
+    if( this->videoStreamIndex < 0 ){
+        throw VideoDecoderError( "video file not opened" );
+    }
+    AVStream* stream = this->format_ctx->streams[this->videoStreamIndex];
+    // frame number -> stream time base, this throws if the frame rate is unknown
+    int64_t ts = std::llround( frameIndex / this->getFrameRate() / av_q2d( stream->time_base ) );
+    if( stream->start_time != AV_NOPTS_VALUE ){
+        ts = ts + stream->start_time;
+    }
+    // land on the nearest keyframe before the requested frame
+    this->stopDemuxer();
+    int ret = av_seek_frame( this->format_ctx, this->videoStreamIndex, ts, AVSEEK_FLAG_BACKWARD );
+    this->startDemuxer();
+    if( ret < 0 ){
+        throw VideoDecoderError( "seeking failed" );
+    }
+    avcodec_flush_buffers( this->codec_ctx );
+    if( this->has_packet ){
+        av_packet_unref(&(this->packet));
+        this->has_packet = false;
+    }
+    // frame counting is lost, take the index of the next frame from its timestamp
+    this->resyncIndex = true;
+}
+
+std::vector<long int> VideoDecoder::scanKeyframes(){
+    // packet only pass over the whole file, nothing gets decoded
+    std::vector<long int> keyframes;
+    // read the packets here, not through the packet queue
+    this->stopDemuxer();
+    AVPacket pkt;
+    av_init_packet( &pkt );
+    pkt.data = NULL;
+    pkt.size = 0;
+    while( av_read_frame( this->format_ctx, &pkt ) >= 0 ){
+        if( pkt.stream_index == this->videoStreamIndex && (pkt.flags & AV_PKT_FLAG_KEY) ){
+            int64_t pts = ( pkt.pts != AV_NOPTS_VALUE ) ? pkt.pts : pkt.dts;
+            if( pts != AV_NOPTS_VALUE ){
+                keyframes.push_back( this->ptsToFrameIndex( pts ) );
+            }
+        }
+        av_packet_unref( &pkt );
+    }
+    std::sort( keyframes.begin(), keyframes.end() );
+    keyframes.erase( std::unique( keyframes.begin(), keyframes.end() ), keyframes.end() );
+    return keyframes;
 }
 
 
@@ -109,7 +416,7 @@ void VideoDecoder::decodeFrame( VideoFrame& frame ){
         
         if( ! this->has_packet ){
             // only read a new packet if the last packet has been processed
-            ret = av_read_frame(this->format_ctx, &(this->packet));
+            ret = this->readPacket( &(this->packet) );
             if( ret == AVERROR_EOF ){
                 throw VideoDecoderError( "EOF" );
             }
@@ -119,7 +426,12 @@ void VideoDecoder::decodeFrame( VideoFrame& frame ){
             this->has_packet = true;
         }
 
-        if( this->packet.stream_index == this->videoStreamIndex ){
+        if( this->keyframesOnly && this->packet.stream_index == this->videoStreamIndex
+                && !(this->packet.flags & AV_PKT_FLAG_KEY) ){
+            // do not even hand non-key packets to the decoder
+            av_packet_unref(&(this->packet));
+            this->has_packet = false; 
+        }else if( this->packet.stream_index == this->videoStreamIndex ){
             ret = avcodec_send_packet(this->codec_ctx, &(this->packet) );
             if(ret == AVERROR(EAGAIN) ){
                 // pass, receive frame and retry send on the next iteration
@@ -141,6 +453,10 @@ void VideoDecoder::decodeFrame( VideoFrame& frame ){
             }else{
                 got_frame = 1;
                 avframe->pts = av_frame_get_best_effort_timestamp(avframe);
+                if( (this->keyframesOnly || this->resyncIndex) && avframe->pts != AV_NOPTS_VALUE ){
+                    this->frameCount = this->ptsToFrameIndex( avframe->pts );
+                    this->resyncIndex = false;
+                }
                 frame.setIndex( this->frameCount );
                 frame.setDimensions( avframe->width, avframe->height );
                 frame.setTimestamp( av_q2d( this->format_ctx->streams[this->videoStreamIndex]->time_base )* (avframe->pts) );
@@ -4,6 +4,10 @@
 #include <exception>
 #include <string>
 #include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 extern "C" {
     #include <libavcodec/avcodec.h>
@@ -25,6 +29,10 @@ public:
     virtual const char* what() const throw() {
         return message.c_str();
     }
+    // the end of the file, not a failure
+    bool isEof() const {
+        return message == "EOF";
+    }
     virtual ~VideoDecoderError() throw(){}
 
 private:
@@ -32,6 +40,29 @@ private:
 
 };
 
+class PacketQueue{
+
+public:
+    PacketQueue();
+    ~PacketQueue();
+
+    void setMaxLength( size_t len );
+    bool push( AVPacket* packet );
+    int pop( AVPacket* packet );
+    void setError( int err );
+    void abort();
+    void reset();
+
+private:
+    std::deque<AVPacket*> items;
+    size_t maxLength;
+    int error; // set by the demuxer after the last packet, usually AVERROR_EOF
+    bool aborted;
+    std::mutex mutex;
+    std::condition_variable condPush;
+    std::condition_variable condPop;
+};
+
 class VideoDecoder{
 
 public:
@@ -43,11 +74,26 @@ public:
     double getFrameRate();
 
     void setDecoderThreads( int num );
+    void setKeyframesOnly( bool enable );
+    void setReadAhead( int packets );
+    void setIoBufferSize( int bytes );
 
     void openFile( std::string fileName );
     void decodeFrame( VideoFrame& frame );
+    void seekFrame( long int frameIndex );
+    std::vector<long int> scanKeyframes();
 
 private:
+    long int ptsToFrameIndex( int64_t pts );
+    int readPacket( AVPacket* pkt );
+    void demux();
+    void startDemuxer();
+    void stopDemuxer();
+    void openCustomIo( std::string fileName );
+
+    static int ioRead( void* opaque, uint8_t* buf, int size );
+    static int64_t ioSeek( void* opaque, int64_t offset, int whence );
+
     int width;
     int height;
     double frame_rate;
@@ -57,8 +103,20 @@ private:
     AVCodecContext* codec_ctx;
     AVCodecParameters* codec_par;
     int videoStreamIndex;
-    int frameCount;
+    long int frameCount;
     int decoderThreads;
+    bool keyframesOnly; // decode only keyframes, frame index derived from pts
+    bool resyncIndex; // set after a seek, the next frame index is derived from pts
+
+    // demuxing thread reading ahead into the packet queue
+    int readAhead;
+    std::thread demuxThread;
+    PacketQueue packetQueue;
+
+    // custom IO on a plain file descriptor with a large buffer
+    int ioBufferSize;
+    int ioFd;
+    AVIOContext* avio_ctx;
 };
 
 #endif // VIDEO_DECODER_H
@@ -1,5 +1,7 @@
 #include <opencv2/opencv.hpp>
 #include <stdexcept>
+#include <memory>
+#include <mutex>
 
 extern "C" {
     #include <libavcodec/avcodec.h>
@@ -7,6 +9,7 @@ extern "C" {
     #include <libavutil/opt.h>
     #include <libswscale/swscale.h>
     #include <libavutil/pixfmt.h>
+    #include <libavutil/pixdesc.h>
     #include <libavutil/timestamp.h>
 }
 
@@ -18,12 +21,14 @@ VideoFrame::VideoFrame(){
         throw std::runtime_error("avframe is NULL");
     }
     this->sws_ctx = NULL;
+    this->graySwsCtx = NULL;
 }
 
 VideoFrame::VideoFrame( enum AVPixelFormat pix_fmt, int width, int height ){
     this->setDimensions( width, height );
     this->setPixelFormat( pix_fmt );
     this->sws_ctx = NULL;
+    this->graySwsCtx = NULL;
     this->frame = av_frame_alloc();
     if( this->frame == NULL ){
         throw std::runtime_error("avframe is NULL");
@@ -42,6 +47,7 @@ VideoFrame::VideoFrame( enum AVPixelFormat pix_fmt, int width, int height ){
 VideoFrame::~VideoFrame(){
     av_frame_free( &(this->frame) );
     sws_freeContext( this->sws_ctx );
+    sws_freeContext( this->graySwsCtx );
 }
 
 cv::Mat VideoFrame::toMat(){
@@ -55,19 +61,52 @@ cv::Mat VideoFrame::toMat(){
         throw std::runtime_error("sws_ctx is NULL");
     }
 
-    // get a temprary frame for format conversion
-    VideoFrame tempFrame( AV_PIX_FMT_BGR24, this->frame->width, this->frame->height);
-    AVFrame* frame2 = tempFrame.getAvFrame();
-
-    // convert to BGR24 for openCV
+    // convert to BGR24 for openCV, straight into the pixel data of the Mat
+    cv::Mat img( this->frame->height, this->frame->width, CV_8UC3 );
+    uint8_t* dstData[1] = { img.data };
+    int dstLinesize[1] = { (int) img.step };
     sws_scale( this->sws_ctx,  this->frame->data, 
         this->frame->linesize, 0, this->frame->height, 
-        frame2->data, frame2->linesize);
-    
-    // create the Mat from pixel data
-    cv::Mat img(this->frame->height, this->frame->width, CV_8UC3, 
-        frame2->data[0], frame2->linesize[0]);
-    return img.clone();
+        dstData, dstLinesize);
+    return img;
+}
+
+bool VideoFrame::hasLumaPlane(){
+    // 8 bit luma (or gray) samples packed in plane 0, as in the planar YUV formats and NV12
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get( this->pixelFormat );
+    if( desc == NULL || desc->nb_components < 1 ){
+        return false;
+    }
+    if( desc->flags & (AV_PIX_FMT_FLAG_RGB | AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_HWACCEL) ){
+        return false;
+    }
+    return desc->comp[0].plane == 0 && desc->comp[0].step == 1 && desc->comp[0].offset == 0
+        && desc->comp[0].shift == 0 && desc->comp[0].depth == 8 && this->frame->linesize[0] > 0;
+}
+
+cv::Mat VideoFrame::toGrayMat(){
+    if( this->hasLumaPlane() ){
+        // the Y plane is the grayscale image: no copy, no conversion.
+        // The Mat references the frame's buffer, keep this frame alive while using it.
+        return cv::Mat( this->frame->height, this->frame->width, CV_8UC1, 
+            this->frame->data[0], this->frame->linesize[0] );
+    }
+
+    // other formats (RGB, packed YUV, high bit depth): convert to GRAY8
+    this->graySwsCtx = sws_getCachedContext( this->graySwsCtx, 
+        this->frame->width, this->frame->height, this->pixelFormat, 
+        this->frame->width, this->frame->height, AV_PIX_FMT_GRAY8,
+        SWS_POINT,NULL,NULL,0 );
+    if( this->graySwsCtx == NULL ){
+        throw std::runtime_error("sws_ctx is NULL");
+    }
+    cv::Mat img( this->frame->height, this->frame->width, CV_8UC1 );
+    uint8_t* dstData[1] = { img.data };
+    int dstLinesize[1] = { (int) img.step };
+    sws_scale( this->graySwsCtx,  this->frame->data, 
+        this->frame->linesize, 0, this->frame->height, 
+        dstData, dstLinesize);
+    return img;
 }
 
 /* Setters */
@@ -110,3 +149,56 @@ enum AVPixelFormat VideoFrame::getPixelFormat(){
     return this->pixelFormat;
 }
 
+
+
+
+/*
+
+    Video Frame Pool
+
+ */
+
+VideoFramePool::VideoFramePool(){
+    this->capacity = 8;
+}
+
+VideoFramePool::~VideoFramePool(){
+    for( auto frame : this->idleFrames ){
+        delete frame;
+    }
+}
+
+void VideoFramePool::setCapacity( size_t num ){
+    std::unique_lock<std::mutex> mlock( this->mutex );
+    this->capacity = num;
+}
+
+std::shared_ptr<VideoFrame> VideoFramePool::acquire(){
+    VideoFrame* frame = NULL;
+    std::unique_lock<std::mutex> mlock( this->mutex );
+    if( ! this->idleFrames.empty() ){
+        frame = this->idleFrames.back();
+        this->idleFrames.pop_back();
+    }else{
+        frame = new VideoFrame();
+    }
+    mlock.unlock();
+
+    // the frame returns to the pool once the last worker drops it. 
+    // The deleter keeps the pool alive as long as frames are out.
+    std::shared_ptr<VideoFramePool> self = this->shared_from_this();
+    return std::shared_ptr<VideoFrame>( frame, [self]( VideoFrame* f ){ self->release( f ); } );
+}
+
+void VideoFramePool::release( VideoFrame* frame ){
+    // hand the pixel buffer back to the decoder's buffer pool right away
+    av_frame_unref( frame->getAvFrame() );
+
+    std::unique_lock<std::mutex> mlock( this->mutex );
+    if( this->idleFrames.size() < this->capacity ){
+        this->idleFrames.push_back( frame );
+        return;
+    }
+    mlock.unlock();
+    delete frame;
+}
@@ -2,6 +2,9 @@
 #define VIDEO_FRAME_H
 
 #include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
 #include <opencv2/opencv.hpp>
 
 extern "C" {
@@ -10,6 +13,7 @@ extern "C" {
     #include <libavutil/opt.h>
     #include <libswscale/swscale.h>
     #include <libavutil/pixfmt.h>
+    #include <libavutil/pixdesc.h>
     #include <libavutil/timestamp.h>
 }
 
@@ -35,6 +39,8 @@ public:
     void setPixelFormat( enum AVPixelFormat pixelFormat );
     
     cv::Mat toMat();
+    cv::Mat toGrayMat();
+    bool hasLumaPlane();
     
 
 private:
@@ -43,7 +49,9 @@ private:
     VideoFrame& operator=(const VideoFrame& that);
 
     AVFrame* frame;
-    struct SwsContext* sws_ctx;
+    // one per target format, a frame converted to both keeps both cached
+    struct SwsContext* sws_ctx; // BGR24
+    struct SwsContext* graySwsCtx; // GRAY8
     int width;
     int height;
     long int index; // frame number
@@ -51,4 +59,23 @@ private:
     enum AVPixelFormat pixelFormat;
 };
 
+
+class VideoFramePool : public std::enable_shared_from_this<VideoFramePool>{
+
+public:
+    VideoFramePool();
+    ~VideoFramePool();
+
+    void setCapacity( size_t num );
+
+    std::shared_ptr<VideoFrame> acquire();
+
+private:
+    void release( VideoFrame* frame );
+
+    std::vector<VideoFrame*> idleFrames;
+    size_t capacity; // idle frames kept for reuse
+    std::mutex mutex;
+};
+
 #endif // VIDEO_FRAME_H
\ No newline at end of file
@@ -4,12 +4,14 @@
 #include <memory>
 #include <condition_variable>
 #include <cstdio>
+#include <iostream>
 #include <opencv2/opencv.hpp>
 #include <opencv2/imgproc.hpp>
 #include <math.h>
 
 #include "Worker.h"
 #include "VideoFrame.h"
+#include "VideoDecoder.h"
 #include "Match.h"
 #include "SurfMatcher.h"
 
@@ -52,6 +54,86 @@ void Worker::doWork( Worker* self ){
 }
 
 
+/*
+
+    Decode Worker
+
+ */
+
+DecodeWorker::DecodeWorker() : Worker(){
+    this->inputFile = "";
+    this->framePool = std::make_shared<VideoFramePool>();
+}
+
+void DecodeWorker::setInputFile( std::string fileName ){
+    this->inputFile = fileName;
+}
+VideoDecoder& DecodeWorker::getDecoder(){
+    return this->decoder;
+}
+void DecodeWorker::setFramePool( std::shared_ptr<VideoFramePool> pool ){
+    this->framePool = pool;
+}
+
+void DecodeWorker::decodeRange( FrameRange range ){
+    // index of the next frame this range owes the queue
+    long int next = range.first;
+    try{
+        this->decoder.seekFrame( range.first );
+    }catch( VideoDecoderError& e ){
+        std::cerr << "Seek Error: " << e.what() << '\n';
+        this->queue->skipFrames( range.first, range.second );
+        return;
+    }
+
+    while( 1 ){
+        if( this->queue->getTerminate() ){
+            // images found
+            return;
+        }
+
+        std::shared_ptr<VideoFrame> frame = this->framePool->acquire();
+        try{
+            this->decoder.decodeFrame( *frame );
+        }catch( VideoDecoderError& e ){
+            std::cerr << "Decode Error: " << e.what() << '\n';
+            this->queue->skipFrames( next, range.second );
+            return;
+        }
+
+        long int index = frame->getIndex();
+        if( index >= range.second ){
+            // the rest belongs to another range
+            this->queue->skipFrames( next, range.second );
+            return;
+        }
+        if( index < next ){
+            // seeking lands on the keyframe before the range
+            continue;
+        }
+        this->queue->skipFrames( next, index );
+        this->queue->enqueue( frame );
+        next = index + 1;
+    }
+}
+
+void DecodeWorker::work(){
+    // every decode worker has its own AVFormatContext
+    try{
+        this->decoder.openFile( this->inputFile );
+    }catch( VideoDecoderError& e ){
+        std::cerr << "Open Error: " << e.what() << '\n';
+        this->queue->terminate();
+        return;
+    }
+
+    FrameRange range;
+    while( this->queue->dequeueFrameRange( range ) ){
+        this->decodeRange( range );
+    }
+}
+
+
 /*
 
     Match Worker
@@ -60,10 +142,18 @@ void Worker::doWork( Worker* self ){
 
 MatchWorker::MatchWorker() : Worker(){
     this->totalFramesSeen = 0;
+    this->overlayEnabled = false;
 }
 
 void MatchWorker::setMatcher( SurfMatcher matcher ){
     this->matcher = matcher;
+    // a detector of our own, used for every frame of this thread
+    this->matcher.createDetector();
+}
+void MatchWorker::enableOverlay(){
+    this->overlayEnabled = true;
+    // the matcher flags the keypoints to plot, not needed for searching only
+    this->matcher.doMatchedFlags();
 }
 
 
@@ -75,21 +165,18 @@ void MatchWorker::drawKeyPoints( cv::Mat& mat, std::vector<cv::KeyPoint>& keypoi
 }
 
 void MatchWorker::drawKeyPoints( cv::Mat& mat, std::vector<cv::KeyPoint>& keypoints, 
-            std::vector<cv::KeyPoint>& matchedKeypoints ){
-    cv::Scalar color;
-    for( auto& kp : keypoints ){
-        color = cv::Scalar( 0, 0, 255);
-        for( auto& mkp : matchedKeypoints ){
-            if( (int) kp.pt.x == (int) mkp.pt.x && (int) kp.pt.y == (int) mkp.pt.y ){
-                color = cv::Scalar( 0, 255, 0);
-                break;
-            }
-        }
-        cv::circle( mat, kp.pt, std::sqrt(kp.size), color );
+            std::vector<unsigned char>& matchedFlags ){
+    cv::Scalar red( 0, 0, 255 );
+    cv::Scalar green( 0, 255, 0 );
+    for( int i=0; i < keypoints.size(); i++ ){
+        cv::KeyPoint& kp = keypoints[i];
+        cv::circle( mat, kp.pt, std::sqrt(kp.size), matchedFlags[i] ? green : red );
     }
 }
 
 void MatchWorker::work(){
+    // images found by the encode worker drop out of matching
+    this->matcher.setActiveImages( this->queue->getActiveImages() );
     while( 1 ){
         std::shared_ptr<VideoFrame> frame = this->queue->dequeue();
         if( frame == nullptr ){
@@ -97,30 +184,37 @@ void MatchWorker::work(){
             break;
         }
         std::vector<cv::KeyPoint> keypoints;
-        std::vector< std::shared_ptr<Match> > matches;
-        // get a openCV mat for keypoint calc and keypoint plot
-        cv::Mat mat = frame->toMat();
-        // detect keypoints of the frame
-        this->matcher.calcKeyPoints( mat, keypoints );
-        // match keypoints with all images by our copy of the matcher
-        matches = this->matcher.matchKeyPoints( keypoints );
-
-        // plot matches
-        if( matches.size() > 0 ){
-            std::vector<cv::KeyPoint> matchedKeypoints = matches[0]->getMatchedKeypoints();
-            this->drawKeyPoints( mat, keypoints, matchedKeypoints);
-        }else{
-            this->drawKeyPoints( mat, keypoints );
+        // detect keypoints on the luma plane of the frame (no copy for YUV sources)
+        cv::Mat gray = frame->toGrayMat();
+        this->matcher.calcKeyPoints( gray, keypoints );
+
+        // colour conversion only for the output video
+        cv::Mat mat;
+        if( this->overlayEnabled ){
+            mat = frame->toMat();
         }
+        // matching needs the keypoints only, hand the pixels back to the pool right away
+        double frameTimestamp = frame->getTimestamp();
+        long int frameIndex = frame->getIndex();
+        gray.release();
+        frame = nullptr;
+
+        // match keypoints with all images by our copy of the matcher
+        std::shared_ptr<FrameResult> result = this->matcher.matchKeyPoints( keypoints );
 
-        for( auto& match : matches ){
-            // set match infos and enqueue match for checking and video write
-            match->setOutputMat( mat );
-            match->setFrameTimestamp( frame->getTimestamp() );
-            match->setFrameIndex( frame->getIndex() );
-            match->setKeypointCount( keypoints.size() );
-            this->queue->enqueueMatch( match );
+        if( this->overlayEnabled ){
+            if( result->hasMatchedFlags() ){
+                this->drawKeyPoints( mat, keypoints, result->getMatchedFlags() );
+            }else{
+                this->drawKeyPoints( mat, keypoints );
+            }
         }
+
+        // set frame infos and enqueue the result for checking and video write
+        result->setOutputMat( mat );
+        result->setFrameTimestamp( frameTimestamp );
+        result->setFrameIndex( frameIndex );
+        this->queue->enqueueResult( result );
     }
 }
 
@@ -139,8 +233,8 @@ EncodeWorker::EncodeWorker() : Worker(){
     this->frameRate = 25.0;
 }
 
-void EncodeWorker::setMatcher( SurfMatcher matcher ){
-    this->matcher = matcher;
+void EncodeWorker::setImages( std::shared_ptr< std::vector<InputImage> > images ){
+    this->results = ImageResults( images );
 }
 void EncodeWorker::setImageCount( int num ){
     this->imageCount = num;
@@ -157,7 +251,7 @@ void EncodeWorker::enableEncode(){
 }
 
 void EncodeWorker::dumpBestMatch(){
-    this->matcher.dumpBestMatch();
+    this->results.dumpBestMatch();
 }
 
 void EncodeWorker::work(){
@@ -169,58 +263,71 @@ void EncodeWorker::work(){
     }
 
     while( 1 ){
-        std::shared_ptr<Match> match = this->queue->dequeueMatch();
-        if( match == nullptr ){
+        std::shared_ptr<FrameResult> result = this->queue->dequeueResult();
+        if( result == nullptr ){
             // we want to quit
             break;
         }
-        int imageIndex = match->getImageIndex();
 
-        if( imageIndex == 0 && this->encodeEnabled ){
+        if( this->encodeEnabled ){
             // write output video for first image (keypoint matches plotted)
             if( ! videoOpen ){
-                writer.open( this->outputFile, CV_FOURCC('M','P','E','G'), this->frameRate, match->getOutputMat().size(), true );
+                writer.open( this->outputFile, CV_FOURCC('M','P','E','G'), this->frameRate, result->getOutputMat().size(), true );
                 videoOpen = true;
             }
-            writer.write( match->getOutputMat() );
+            writer.write( result->getOutputMat() );
         }
-        // update the images of the matcher of _this_ thread to current best match 
-        this->matcher.updateBestMatch( match );
-        this->matcher.updateMatchAverages( match );
-
-        // stats line 
-        long totalKeypointHit = this->matcher.getTotalKeypointHit( match );
-        long totalKeypointMiss = this->matcher.getTotalKeypointMiss( match );
-        match->dumpStatus( this->totalFramesSeen, totalKeypointHit, totalKeypointMiss );
+        for( int imageIndex=0; imageIndex < result->getImageCount(); imageIndex++ ){
+            this->processMatch( result->getMatch( imageIndex ) );
+        }
+    }
+}
 
+void EncodeWorker::processMatch( Match match ){
+    int imageIndex = match.getImageIndex();
+    if( match.isSkipped() ){
+        // the image has been found, it was not matched to this frame
         if( imageIndex == 0){
             this->totalFramesSeen++;
         }
+        return;
+    }
+    // update the results of the image to current best match 
+    this->results.updateBestMatch( match );
+    this->results.updateMatchAverages( match );
 
-        // notify the queue the image has been found and we are ready to terminate
-        // videos have streaks of similar images. Once we found a full match 
-        // we check the next frames if there may be a even better match.
-        int extraFrames = this->imagesFound.at( imageIndex );
-        if( this->matcher.isFullMatch(match) ){
-            if( extraFrames == -1 ){
-                // do nothing, since the queue has been notified
-            }else if( extraFrames == -2 ){
-                this->imagesFound[ imageIndex ] = 1;
-            }else if(extraFrames >= 0 ){
-                // for each frame meeting the full match criteria, add a extra frame to check
-                // 0 is the edge case: the next not fully matched frame would have notified the queue
-                this->imagesFound[ imageIndex ] = extraFrames + 1; // TODO make steps configurable
-            }
-        }else{
-            if(extraFrames > 0 ){
-                // for each frame which is not a full match count down 
-                // untill we are sure there will be no candidate for a event better match
-                this->imagesFound[ imageIndex ] = extraFrames - 1; // TODO make steps configurable
-            }else if(extraFrames == 0 ){
-                // notify the queue that this image has been found
-                this->imagesFound[ imageIndex ] = -1;
-                this->queue->imageFound();
-            }
+    // stats line 
+    long totalKeypointHit = this->results.getTotalKeypointHit( imageIndex );
+    long totalKeypointMiss = this->results.getTotalKeypointMiss( imageIndex );
+    match.dumpStatus( this->totalFramesSeen, totalKeypointHit, totalKeypointMiss );
+
+    if( imageIndex == 0){
+        this->totalFramesSeen++;
+    }
+
+    // notify the queue the image has been found and we are ready to terminate
+    // videos have streaks of similar images. Once we found a full match 
+    // we check the next frames if there may be a even better match.
+    int extraFrames = this->imagesFound.at( imageIndex );
+    if( this->results.isFullMatch(match) ){
+        if( extraFrames == -1 ){
+            // do nothing, since the queue has been notified
+        }else if( extraFrames == -2 ){
+            this->imagesFound[ imageIndex ] = 1;
+        }else if(extraFrames >= 0 ){
+            // for each frame meeting the full match criteria, add a extra frame to check
+            // 0 is the edge case: the next not fully matched frame would have notified the queue
+            this->imagesFound[ imageIndex ] = extraFrames + 1; // TODO make steps configurable
+        }
+    }else{
+        if(extraFrames > 0 ){
+            // for each frame which is not a full match count down 
+            // untill we are sure there will be no candidate for a event better match
+            this->imagesFound[ imageIndex ] = extraFrames - 1; // TODO make steps configurable
+        }else if(extraFrames == 0 ){
+            // notify the queue that this image has been found
+            this->imagesFound[ imageIndex ] = -1;
+            this->queue->imageFound( imageIndex );
         }
     }
 }
@@ -7,7 +7,9 @@
 #include <condition_variable>
 
 #include "VideoFrame.h"
+#include "VideoDecoder.h"
 #include "SurfMatcher.h"
+#include "ImageResults.h"
 #include "WorkerQueue.h"
 
 
@@ -32,6 +34,25 @@ protected:
 };
 
 
+class DecodeWorker : public Worker{
+
+public:
+    DecodeWorker();
+    void work();
+
+    void setInputFile( std::string fileName );
+    VideoDecoder& getDecoder();
+    void setFramePool( std::shared_ptr<VideoFramePool> pool );
+
+    void decodeRange( FrameRange range );
+
+private:
+    VideoDecoder decoder;
+    std::shared_ptr<VideoFramePool> framePool;
+    std::string inputFile;
+};
+
+
 class MatchWorker : public Worker{
 
 public:
@@ -39,15 +60,18 @@ public:
     void work();
 
     void setMatcher( SurfMatcher matcher );
+    void enableOverlay();
 
     void drawKeyPoints( cv::Mat& mat, std::vector<cv::KeyPoint>& keypoints);
+    // matchedFlags: one entry per keypoint, matched ones are drawn green
     void drawKeyPoints( cv::Mat& mat, std::vector<cv::KeyPoint>& keypoints, 
-                std::vector<cv::KeyPoint>& matchedKeypoints );
+                std::vector<unsigned char>& matchedFlags );
 
 
 private:
     long totalFramesSeen;
     SurfMatcher matcher;
+    bool overlayEnabled; // render the keypoints onto a colour frame for the output video
 };
 
 class EncodeWorker : public Worker{
@@ -61,12 +85,16 @@ public:
     void enableEncode();
     void setFrameRate( double rate );
     
-    void setMatcher( SurfMatcher matcher );
+    void setImages( std::shared_ptr< std::vector<InputImage> > images );
     void dumpBestMatch();
 
 private:
+    // stats and found state of one image of the frame
+    void processMatch( Match match );
+
     long totalFramesSeen;
-    SurfMatcher matcher;
+    // only this thread updates the results
+    ImageResults results;
 
     bool encodeEnabled;
     std::string outputFile;
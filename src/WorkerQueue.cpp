@@ -2,25 +2,17 @@
 #include <thread>
 #include <mutex>
 #include <condition_variable>
+#include <atomic>
+#include <cstdint>
 #include <memory>
 #include <queue>
+#include <map>
+#include <algorithm>
 #include <opencv2/opencv.hpp>
 
 #include "WorkerQueue.h"
 #include "VideoFrame.h"
-#include "Match.h"
-
-bool MatchComparator::operator() (std::shared_ptr<Match> m1, std::shared_ptr<Match> m2) {
-    long int frame1 = m1->getFrameIndex();
-    long int frame2 = m2->getFrameIndex();
-    if( frame1 > frame2 ){
-        return true;
-    }else if( frame1 < frame2 ){
-        return false;
-    }else{
-        return ( m1->getImageIndex() < m2->getImageIndex() );
-    }
-}
+#include "FrameResult.h"
 
 bool VideoFrameComparator::operator() (std::shared_ptr<VideoFrame> f1, std::shared_ptr<VideoFrame> f2) {
     return (f1->getIndex() > f2->getIndex()); // sort smallest index first
@@ -31,16 +23,35 @@ WorkerQueue::WorkerQueue(){
     this->imageCount = 0;
     this->imagesFound = 0;
     this->doTerminate = false;
-    this->matchDequeueIndex = -1;
-    this->matchDequeueImageCount = 0;
+    this->doFinish = false;
+    this->frameRangesEnd = 0;
+    this->reorderWindow = 64;
+    this->matchNextIndex = -1;
+    this->ring = nullptr;
+    this->ringEnqWaiters = 0;
+    this->ringDeqWaiters = 0;
 }
 
 void WorkerQueue::setMaxLength( size_t len ){
     this->maxLength = len;
 }
 
+void WorkerQueue::setReorderWindow( long int frames ){
+    this->reorderWindow = std::max( frames, 1L );
+}
+
 void WorkerQueue::setImageCount( int num ){
     this->imageCount = num;
+    this->activeImages = std::make_shared<ActiveImages>( num );
+}
+
+void WorkerQueue::doRingBuffer(){
+    // frames arrive about in order from the decoders, a FIFO is good enough
+    this->ring = std::make_unique<FrameRing>( this->maxLength );
+}
+
+std::shared_ptr<ActiveImages> WorkerQueue::getActiveImages(){
+    return this->activeImages;
 }
 
 void WorkerQueue::terminate(){
@@ -51,7 +62,18 @@ void WorkerQueue::terminate(){
     mlock.unlock();
     // notify all consumer blocking on dequeue()
     this->condDeq.notify_all();
-    this->matchCondDeq.notify_all();
+    this->wakeMatches();
+    this->wakeRing();
+}
+
+void WorkerQueue::finish(){
+    // exclusive access
+    std::unique_lock mlock( this->doTerminateMutex );
+    this->doFinish = true;
+    mlock.unlock();
+    // consumers blocking on dequeue() quit once the queue is empty
+    this->condDeq.notify_all();
+    this->wakeRing();
 }
 
 bool WorkerQueue::getTerminate(){
@@ -61,7 +83,11 @@ bool WorkerQueue::getTerminate(){
     return term;
 }
 
-void WorkerQueue::imageFound(){
+void WorkerQueue::imageFound( int imageIndex ){
+    // the match workers stop matching the image with their next frame
+    if( this->activeImages != nullptr ){
+        this->activeImages->deactivate( imageIndex );
+    }
     // exclusive access
     std::unique_lock mlock( this->doTerminateMutex );
     // terminate if all images have been found
@@ -72,23 +98,27 @@ void WorkerQueue::imageFound(){
     mlock.unlock();
     // notify all consumer blocking on dequeue()
     this->condDeq.notify_all();
-    this->matchCondDeq.notify_all();
+    this->wakeMatches();
+    this->wakeRing();
 }
 
 std::shared_ptr<VideoFrame> WorkerQueue::dequeue(){
+    if( this->ring != nullptr ){
+        return this->dequeueRing();
+    }
     // exclusive access
     std::unique_lock<std::mutex> mlock( this->mutex );
     // shared read access
     std::shared_lock doTerminateLock( this->doTerminateMutex );
 
-    while( this->items.empty() && ! this->doTerminate){
+    while( this->items.empty() && ! this->doTerminate && ! this->doFinish ){
         doTerminateLock.unlock();
         // wait until item arrives
         this->condDeq.wait(mlock);
         doTerminateLock.lock();
     }
 
-    if( this->doTerminate ){
+    if( this->doTerminate || this->items.empty() ){
         // release the locks in order to prevent deadlock
         doTerminateLock.unlock();
         mlock.unlock();
@@ -109,6 +139,11 @@ std::shared_ptr<VideoFrame> WorkerQueue::dequeue(){
 }
 
 void WorkerQueue::enqueue( std::shared_ptr<VideoFrame> frame){
+    this->waitForWindow( frame->getIndex() );
+    if( this->ring != nullptr ){
+        this->enqueueRing( frame );
+        return;
+    }
     // exclusive access
     std::unique_lock<std::mutex> mlock( this->mutex );
     // shared read access
@@ -141,77 +176,194 @@ void WorkerQueue::enqueue( std::shared_ptr<VideoFrame> frame){
 
 
 
-std::shared_ptr<Match> WorkerQueue::dequeueMatch(){
-    // output the frames in sequencial order.
-    std::unique_lock<std::mutex> mlock( this->matchMutex );
-    std::shared_lock doTerminateLock( this->doTerminateMutex );
-
-    bool found = true;
-    while( true ){
-        if( this->doTerminate && this->matchItems.empty() ){
-            // empty the queue before terminate
+std::shared_ptr<VideoFrame> WorkerQueue::dequeueRing(){
+    std::shared_ptr<VideoFrame> item;
+    while( ! this->doTerminate ){
+        // read before the pop, no frame follows once it is set
+        bool finished = this->doFinish;
+        if( this->ring->pop( item ) ){
+            if( this->ringEnqWaiters > 0 ){
+                // the lock orders us after a producer going to sleep
+                std::lock_guard<std::mutex> lock( this->ringMutex );
+                this->ringCondEnq.notify_one();
+            }
+            return item;
+        }
+        if( finished ){
             break;
         }
-        doTerminateLock.unlock();
+        std::unique_lock<std::mutex> lock( this->ringMutex );
+        this->ringDeqWaiters++;
+        if( this->ring->empty() && ! this->doTerminate && ! this->doFinish ){
+            this->ringCondDeq.wait( lock );
+        }
+        this->ringDeqWaiters--;
+    }
+    return nullptr;
+}
 
-        if( ! this->matchItems.empty() ){
-            std::shared_ptr<Match> item = this->matchItems.top();
-            if( this->matchDequeueIndex < 0 ){
-                // init -> set up like we just dequeued the last match from the preceeding frame
-                // there is a chance we do not get the really first frame -> handle special later
-                this->matchDequeueIndex = item->getFrameIndex()-1;
-                this->matchDequeueImageCount = this->imageCount;
+void WorkerQueue::enqueueRing( std::shared_ptr<VideoFrame> frame ){
+    while( ! this->doTerminate ){
+        if( this->ring->push( frame ) ){
+            if( this->ringDeqWaiters > 0 ){
+                std::lock_guard<std::mutex> lock( this->ringMutex );
+                this->ringCondDeq.notify_one();
             }
-            long int dqIdx = this->matchDequeueIndex;
-            long int frameIdx = item->getFrameIndex();
-
-            if( dqIdx+1 == frameIdx || frameIdx <= dqIdx ){
-                if( frameIdx < dqIdx+1 ){
-                    // frame too late -> pretend it has never existed
-                }else{
-                    if( this->matchDequeueImageCount == this->imageCount ){
-                        this->matchDequeueImageCount = 0;
-                        this->matchDequeueIndex = frameIdx; // max(dqIdx,frameIdx)==frameIdx at this point
-                    }
-                    this->matchDequeueImageCount = this->matchDequeueImageCount +1;
+            return;
+        }
+        std::unique_lock<std::mutex> lock( this->ringMutex );
+        this->ringEnqWaiters++;
+        if( this->ring->full() && ! this->doTerminate ){
+            this->ringCondEnq.wait( lock );
+        }
+        this->ringEnqWaiters--;
+    }
+    // terminating, nobody will dequeue the frame
+}
+
+void WorkerQueue::wakeRing(){
+    // after changing a flag, sleepers check the flags under the lock
+    std::lock_guard<std::mutex> lock( this->ringMutex );
+    this->ringCondEnq.notify_all();
+    this->ringCondDeq.notify_all();
+}
+
+
+std::shared_ptr<FrameResult> WorkerQueue::dequeueResult(){
+    // output the results in frame order
+    std::unique_lock<std::mutex> mlock( this->matchMutex );
+    while( true ){
+        if( this->matchNextIndex >= 0 ){
+            long int frameIdx = this->matchNextIndex;
+            std::shared_ptr<FrameResult>* slot = &this->resultSlots[ frameIdx % this->reorderWindow ];
+            if( ( *slot == nullptr || (*slot)->getFrameIndex() != frameIdx ) && this->doTerminate ){
+                // frames in between may have been dropped, flush the rest in order
+                frameIdx = this->firstPendingFrame();
+                if( frameIdx < 0 ){
+                    break;
                 }
-                // dequeue the match
-                (this->matchItems).pop();
+                slot = &this->resultSlots[ frameIdx % this->reorderWindow ];
+            }
+            if( *slot != nullptr && (*slot)->getFrameIndex() == frameIdx ){
+                std::shared_ptr<FrameResult> item = *slot;
+                *slot = nullptr;
+                // frame done, the window moves on
+                this->matchNextIndex = this->nextMatchIndex( frameIdx );
                 mlock.unlock();
-                // notify producer blocking on enqueue()
                 this->matchCondEnq.notify_all();
-                found = true;
                 return item;
-            }else{
-                found = false;
             }
+        }else if( this->doTerminate ){
+            break;
         }
-
-        if( this->matchItems.empty() || ! found ){
-            // wait until item arrives
-            this->matchCondDeq.wait(mlock);
-        }
-
-        // lock for next iteration
-        doTerminateLock.lock();
+        // wait until the next frame arrives
+        this->matchCondDeq.wait( mlock );
     }
-
-    // release the locks in order to prevent deadlock
-    doTerminateLock.unlock();
     mlock.unlock();
-    // notify all producer blocking on enqueue() to ensure termination
+    // notify all producer blocking on the window to ensure termination
     this->matchCondEnq.notify_all();
     return nullptr;
 }
 
 
-void WorkerQueue::enqueueMatch( std::shared_ptr<Match> match){
+void WorkerQueue::enqueueResult( std::shared_ptr<FrameResult> result ){
     // exclusive access
     std::unique_lock<std::mutex> mlock( this->matchMutex );
-    // no guard against a full buffer.
-    this->matchItems.push( match );
+    long int frameIdx = result->getFrameIndex();
+    if( this->matchNextIndex < 0 || frameIdx < this->matchNextIndex ){
+        // frame too late -> pretend it has never existed
+        return;
+    }
+    // the frame was inside the window when it was queued, its slot is free
+    this->resultSlots[ frameIdx % this->reorderWindow ] = result;
+    bool wake = frameIdx == this->matchNextIndex;
+    mlock.unlock();
+    if( wake ){
+        // only the encode worker dequeues results
+        this->matchCondDeq.notify_one();
+    }
+}
+
+void WorkerQueue::waitForWindow( long int frameIndex ){
+    std::unique_lock<std::mutex> mlock( this->matchMutex );
+    if( this->matchNextIndex < 0 ){
+        // the first frame: frame ranges and skipped frames tell where the matches start,
+        // otherwise a single decoder delivers in order
+        bool startKnown = ! this->skippedFrames.empty() || this->frameRangesEnd > 0;
+        this->matchNextIndex = startKnown ? this->nextMatchIndex( -1 ) : frameIndex;
+        this->resultSlots.assign( this->reorderWindow, nullptr );
+    }
+    // the results of at most reorderWindow frames are buffered
+    while( frameIndex >= this->matchNextIndex + this->reorderWindow && ! this->doTerminate ){
+        this->matchCondEnq.wait( mlock );
+    }
+}
 
+long int WorkerQueue::firstPendingFrame(){
+    // call with matchMutex locked, lowest frame with a queued result or -1
+    long int first = -1;
+    for( auto& slot : this->resultSlots ){
+        if( slot != nullptr && slot->getFrameIndex() >= this->matchNextIndex 
+                && ( first < 0 || slot->getFrameIndex() < first ) ){
+            first = slot->getFrameIndex();
+        }
+    }
+    return first;
+}
+
+void WorkerQueue::wakeMatches(){
+    // after changing a flag, the waiters check the flags under the lock
+    std::lock_guard<std::mutex> lock( this->matchMutex );
+    this->matchCondDeq.notify_all();
+    this->matchCondEnq.notify_all();
+}
+
+void WorkerQueue::skipFrames( long int from, long int to ){
+    if( to <= from ){
+        return;
+    }
+    // the producer promises to never enqueue the frames [from, to)
+    std::unique_lock<std::mutex> mlock( this->matchMutex );
+    this->skippedFrames[ from ] = to;
+    bool moved = false;
+    if( this->matchNextIndex == from ){
+        this->matchNextIndex = this->nextMatchIndex( from-1 );
+        moved = true;
+    }
     mlock.unlock();
+    // the consumer may wait for the first of the skipped frames
     this->matchCondDeq.notify_all();
+    if( moved ){
+        // the window moved on, producers may wait for it
+        this->matchCondEnq.notify_all();
+    }
+}
+
+void WorkerQueue::addFrameRange( FrameRange range ){
+    std::unique_lock<std::mutex> mlock( this->frameRangesMutex );
+    // ranges are added in order, the frames in between are never decoded
+    this->skipFrames( this->frameRangesEnd, range.first );
+    this->frameRanges.push_back( range );
+    this->frameRangesEnd = range.second;
+}
+
+bool WorkerQueue::dequeueFrameRange( FrameRange& range ){
+    std::unique_lock<std::mutex> mlock( this->frameRangesMutex );
+    if( this->frameRanges.empty() || this->getTerminate() ){
+        return false;
+    }
+    range = this->frameRanges.front();
+    this->frameRanges.pop_front();
+    return true;
 }
 
+long int WorkerQueue::nextMatchIndex( long int frameIndex ){
+    // call with matchMutex locked
+    long int next = frameIndex + 1;
+    auto it = this->skippedFrames.find( next );
+    while( it != this->skippedFrames.end() ){
+        next = it->second;
+        it = this->skippedFrames.find( next );
+    }
+    return next;
+}
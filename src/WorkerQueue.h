@@ -6,17 +6,21 @@
 #include <mutex>
 #include <shared_mutex>
 #include <condition_variable>
+#include <atomic>
+#include <cstddef>
 #include <memory>
 #include <queue>
+#include <map>
+#include <deque>
+#include <utility>
 #include <opencv2/opencv.hpp>
 
-#include "Match.h"
+#include "FrameResult.h"
 #include "VideoFrame.h"
+#include "ActiveImages.h"
+#include "FrameRing.h"
 
-class MatchComparator{
-public:
-    bool operator() (std::shared_ptr<Match> m1, std::shared_ptr<Match> m2);
-};
+typedef std::pair<long int, long int> FrameRange; // frames [first, second)
 
 class VideoFrameComparator{
 public:
@@ -28,22 +32,45 @@ class WorkerQueue{
 public:
     WorkerQueue();
     void terminate();
+    void finish();
     bool getTerminate();
     void setMaxLength( size_t len );
     void setImageCount( int num );
+    // frames whose results may be buffered, producers wait for the frames beyond
+    void setReorderWindow( long int frames );
+    // call after setMaxLength(), before frames are queued
+    void doRingBuffer();
 
-    void imageFound();
+    void imageFound( int imageIndex );
+    std::shared_ptr<ActiveImages> getActiveImages();
 
     std::shared_ptr<VideoFrame> dequeue();
     void enqueue( std::shared_ptr<VideoFrame> frame);
     
-    std::shared_ptr<Match> dequeueMatch();
-    void enqueueMatch( std::shared_ptr<Match> match);
+    std::shared_ptr<FrameResult> dequeueResult();
+    void enqueueResult( std::shared_ptr<FrameResult> result );
+    void skipFrames( long int from, long int to );
+
+    void addFrameRange( FrameRange range );
+    bool dequeueFrameRange( FrameRange& range );
  
 private:
-    bool doTerminate;
+    long int nextMatchIndex( long int frameIndex );
+    void waitForWindow( long int frameIndex );
+    long int firstPendingFrame();
+    void wakeMatches();
+    std::shared_ptr<VideoFrame> dequeueRing();
+    void enqueueRing( std::shared_ptr<VideoFrame> frame );
+    void wakeRing();
+
+    std::atomic<bool> doTerminate;
+    std::atomic<bool> doFinish; // no more frames will be enqueued, drain the queue
     std::shared_mutex doTerminateMutex;
 
+    std::deque<FrameRange> frameRanges; // ranges to be decoded by the decode workers
+    long int frameRangesEnd;
+    std::mutex frameRangesMutex;
+
     size_t maxLength;
 
     // prevent starvation with priority queue
@@ -52,16 +79,26 @@ private:
     std::condition_variable condEnq;
     std::condition_variable condDeq;
 
-    long int matchDequeueIndex; // used to track last dequeued frame index
-    int matchDequeueImageCount; // used to track if all matches from matchDequeueIndex have been dequeued
-    // we use a priority queue sorted first by frame number then by image index
-    std::priority_queue< std::shared_ptr<Match>, std::vector<std::shared_ptr<Match>>, MatchComparator > matchItems;
+    // replaces the priority queue when set, the mutex is only taken to sleep
+    std::unique_ptr<FrameRing> ring;
+    std::mutex ringMutex;
+    std::condition_variable ringCondEnq;
+    std::condition_variable ringCondDeq;
+    std::atomic<int> ringEnqWaiters;
+    std::atomic<int> ringDeqWaiters;
+
+    long int reorderWindow;
+    // the result of frame i waits in slot i % reorderWindow until its frame is next
+    std::vector< std::shared_ptr<FrameResult> > resultSlots;
+    long int matchNextIndex; // next frame to dequeue, -1 until the first frame is queued
+    std::map<long int, long int> skippedFrames; // frame ranges [first, second) which will never be enqueued
     std::mutex matchMutex;
-    std::condition_variable matchCondEnq;
-    std::condition_variable matchCondDeq;
+    std::condition_variable matchCondEnq; // frame producers waiting for the window
+    std::condition_variable matchCondDeq; // encode worker waiting for the next frame
     
     int imageCount;
     int imagesFound;
+    std::shared_ptr<ActiveImages> activeImages;
 
 };
 
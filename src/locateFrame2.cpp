@@ -3,36 +3,58 @@
 #include <thread>
 #include <memory>
 #include <list>
+#include <vector>
+#include <utility>
+#include <limits>
+#include <algorithm>
+#include <chrono>
+#include <string>
 
 #include "Arguments.h"
 #include "VideoDecoder.h"
 #include "VideoFrame.h"
 #include "SurfMatcher.h"
+#include "KeyPointDetector.h"
+#include "DistanceKernels.h"
 #include "WorkerQueue.h"
 #include "Worker.h"
+#include "TaskPool.h"
+#include "KeyPointCache.h"
 
-
-int main(int argc, char **argv) {
-    /// parse arguments
-    Arguments args;
-    args.parseArgs( argc, argv );
-    args.printArguments();
-    // create and configure the decoder
-    VideoDecoder dec;
+/*
+    Apply the decoder options to a decoder instance, before opening the file.
+ */
+void configureDecoder( VideoDecoder& dec, Arguments& args ){
     dec.setDecoderThreads( args.getDecoderThreads() );
-    dec.openFile( args.getInputFile() );
+    dec.setReadAhead( args.getReadAhead() );
+    dec.setIoBufferSize( args.getIoBufferSize() * 1024 );
+}
 
-    // create and configure the master matcher (the threads will get a copy)
-    SurfMatcher matcher;
-    matcher.setVideoDimensions( dec.getWidth(), dec.getHeight() );
+/*
+    Configure the matcher and detect the keypoints of all input images with the given detector.
+ */
+void setupMatcher( Arguments& args, SurfMatcher& matcher, int width, int height, std::string detectorName ){
+    matcher.setVideoDimensions( width, height );
     if( args.doScale() ){
         matcher.doScaleImages();
     }
-    matcher.setHessianThreshold( args.getHessianThreshold() );
+    if( args.doHitMask() ){
+        matcher.doHitMasks();
+    }
+    matcher.setDetectorName( detectorName );
+    matcher.setFastThreshold( args.getFastThreshold() );
+    matcher.setFeatureCount( args.getFeatureCount() );
+    matcher.setScaleLevels( args.getScaleLevels() );
     matcher.setKeypointMatchRadius( args.getKeypointMatchRadius() );
-    // configure the input images (again, each thread will get a copy of all images)
+    matcher.setIndexName( args.getIndexName() );
+    matcher.setVotingMethod( args.getVotingMethod() );
+    if( args.getCacheDir() != "" ){
+        matcher.setCache( std::make_shared<KeyPointCache>( args.getCacheDir() ) );
+    }
+    // configure the input images (the threads share them through the matcher copies)
     std::vector<double> minMatchRatios = args.getMatchRatios();
     std::vector<double> minSnrs = args.getSnrRatios();
+    std::vector<InputImage> images;
     int imageIndex = 0;
     for ( auto &fileName : args.getSearchFiles() ) {
         InputImage img;
@@ -46,84 +68,402 @@ int main(int argc, char **argv) {
             // configure minimum SNR.
             img.setMinSnr( minSnrs.at(imageIndex) );
         }
-        matcher.addImage( img );
+        images.push_back( img );
         imageIndex++;
     }
-    int imageCount = imageIndex; // imageCount is used further down
+    // decode and detect on all cores, the calling thread is one of them
+    int cores = std::thread::hardware_concurrency();
+    TaskPool pool( std::max( 0, cores - 1 ) );
+    matcher.addImages( images, pool );
+    if( args.doSeedTranslation() ){
+        matcher.doSeedTranslations();
+    }
+    if( args.doCandidateFilter() ){
+        matcher.doCandidateFilter( args.getCandidateRatio() );
+    }
+}
+
+/*
+    Run every detector on the same frames and report its cost and how well it finds the images.
+ */
+void runBenchmark( Arguments& args, int width, int height ){
+    typedef std::chrono::steady_clock Clock;
+    int frameCount = args.getBenchmarkFrames();
+
+    for( auto& name : KeyPointDetector::getNames() ){
+        SurfMatcher matcher;
+        setupMatcher( args, matcher, width, height, name );
+        int imageCount = matcher.getImageCount();
+
+        VideoDecoder dec;
+        configureDecoder( dec, args );
+        dec.openFile( args.getInputFile() );
+        if( args.getMinFrame() > 0 ){
+            dec.seekFrame( args.getMinFrame() );
+        }
+
+        long keypointTotal = 0;
+        double detectTotal = 0.0; // ms
+        double matchTotal = 0.0; // ms
+        double ratioTotal = 0.0;
+        std::vector<double> bestRatios( imageCount, 0.0 );
+        int frames = 0;
+        VideoFrame frame;
+        while( frames < frameCount ){
+            try{
+                dec.decodeFrame( frame );
+            }catch( VideoDecoderError& e ){
+                // EOF
+                break;
+            }
+            if( frame.getIndex() < args.getMinFrame() ){
+                continue;
+            }
+            std::vector<cv::KeyPoint> keypoints;
+            cv::Mat mat = frame.toGrayMat();
+
+            Clock::time_point t0 = Clock::now();
+            matcher.calcKeyPoints( mat, keypoints );
+            Clock::time_point t1 = Clock::now();
+            std::shared_ptr<FrameResult> result = matcher.matchKeyPoints( keypoints );
+            Clock::time_point t2 = Clock::now();
+
+            detectTotal += std::chrono::duration<double, std::milli>( t1 - t0 ).count();
+            matchTotal += std::chrono::duration<double, std::milli>( t2 - t1 ).count();
+            keypointTotal += keypoints.size();
+            for( int idx=0; idx < imageCount; idx++ ){
+                ratioTotal += result->getMatchRatio( idx );
+                bestRatios[ idx ] = std::max( bestRatios[ idx ], result->getMatchRatio( idx ) );
+            }
+            frames++;
+        }
+
+        if( frames == 0 || imageCount == 0 ){
+            std::printf( "benchmark %-6s: no frames\n", name.c_str() );
+            continue;
+        }
+        std::printf( "benchmark %-6s: %8.1f keypoints/frame, detect %8.2f ms/frame, match %8.2f ms/frame, avg match %6.2f%%\n", 
+            name.c_str(), keypointTotal*1.0 / frames, detectTotal / frames, matchTotal / frames, 
+            ratioTotal / (frames*imageCount) * 100 );
+        for( int idx=0; idx < imageCount; idx++ ){
+            std::printf( "benchmark %-6s: img%d best match %6.2f%%\n", name.c_str(), idx, bestRatios[idx]*100 );
+        }
+    }
+}
+
+// a range decoded by a parallel decoder spans at least this many frames, so 
+// short GOPs (e.g. intra only codecs) do not cause a seek per frame
+const long int minSegmentLength = 250;
+
+/*
+    Decode only the keyframes and flag the ones reaching the keyframe threshold for any image.
+ */
+void scanKeyframes( Arguments& args, SurfMatcher& matcher, 
+        std::vector<long int>& keyframes, std::vector<bool>& candidates ){
+    VideoDecoder dec;
+    configureDecoder( dec, args );
+    dec.setKeyframesOnly( true );
+    dec.openFile( args.getInputFile() );
+
+    long int maxFrame = args.getMaxFrame();
+    if( args.getMinFrame() > 0 ){
+        dec.seekFrame( args.getMinFrame() );
+    }
+    VideoFrame frame; // reused for every keyframe
+    while( 1 ){
+        try{
+            dec.decodeFrame( frame );
+        }catch( VideoDecoderError& e ){
+            // refine what we have got so far
+            if( ! e.isEof() ){
+                std::cerr << "Decode Error: " << e.what() << '\n';
+            }
+            break;
+        }
+        std::vector<cv::KeyPoint> keypoints;
+        cv::Mat mat = frame.toGrayMat();
+        matcher.calcKeyPoints( mat, keypoints );
+
+        bool candidate = false;
+        std::shared_ptr<FrameResult> result = matcher.matchKeyPoints( keypoints );
+        for( int idx=0; idx < result->getImageCount(); idx++ ){
+            if( result->getMatchRatio( idx ) >= args.getKeyframeThreshold() ){
+                candidate = true;
+                std::fprintf( stderr, "keyframe %ld: candidate for img%d, match %3.3f%%\n", 
+                    frame.getIndex(), idx, result->getMatchRatio( idx )*100 );
+            }
+        }
+        keyframes.push_back( frame.getIndex() );
+        candidates.push_back( candidate );
+
+        if( maxFrame >= 0 && frame.getIndex() >= maxFrame ){
+            break;
+        }
+    }
+}
+
+/*
+    Turn the selected GOPs into frame ranges clipped to [minFrame, maxFrame].
+    Adjacent GOPs are joined until a range spans at least minLength frames.
+ */
+std::vector<FrameRange> gopRanges( Arguments& args, std::vector<long int>& keyframes, 
+        std::vector<bool>& selected, long int minLength ){
+    long int minFrame = args.getMinFrame();
+    long int maxFrame = args.getMaxFrame();
+    std::vector<FrameRange> ranges;
+    for( size_t i=0; i < keyframes.size(); i++ ){
+        if( ! selected[i] ){
+            continue;
+        }
+        long int start = ( i > 0 ) ? keyframes[i] : 0;
+        long int end = ( i+1 < keyframes.size() ) ? keyframes[i+1] : std::numeric_limits<long int>::max();
+        start = std::max( start, minFrame );
+        if( maxFrame >= 0 ){
+            end = std::min( end, maxFrame+1 );
+        }
+        if( start >= end ){
+            continue;
+        }
+        if( ! ranges.empty() && ranges.back().second == start 
+                && ranges.back().second - ranges.back().first < minLength ){
+            ranges.back().second = end;
+        }else{
+            ranges.push_back( FrameRange( start, end ) );
+        }
+    }
+    return ranges;
+}
+
+/*
+    Reorder window for parallel decoding. Each decoder starts its range while the ones 
+    before are still busy, so the window has to reach from the start of a range to the 
+    start of the range decoders-1 later, plus the frames in flight.
+ */
+long int rangesReorderWindow( Arguments& args, std::vector<FrameRange>& ranges ){
+    long int window = args.getReorderWindow();
+    long int inFlight = args.getQueueSize() + args.getMatcherThreads() + args.getDecoders();
+    for( size_t r=0; r < ranges.size(); r++ ){
+        size_t last = std::min( r + args.getDecoders() - 1, ranges.size() - 1 );
+        window = std::max( window, ranges[last].first - ranges[r].first + inFlight );
+    }
+    return window;
+}
+
+/*
+    Prepare the master matcher and start the match and encode workers with copies of it.
+ */
+void startWorkers( Arguments& args, SurfMatcher& matcher, int width, int height, double frameRate,
+        std::shared_ptr<WorkerQueue> queue, std::list< std::shared_ptr<Worker> >& workers, 
+        std::shared_ptr<EncodeWorker> encodeWorker ){
+    // create and configure the master matcher (the threads will get a copy)
+    setupMatcher( args, matcher, width, height, args.getDetectorName() );
+    if( args.getImageThreads() > 0 ){
+        // one pool for all match workers, the copies of the matcher share it
+        matcher.setTaskPool( std::make_shared<TaskPool>( args.getImageThreads() ) );
+    }
 
-    // create and configure the queue used by the workers to communicate
-    std::shared_ptr<WorkerQueue> queue = std::make_shared<WorkerQueue>();
-    queue->setImageCount( imageCount );
-    queue->setMaxLength( args.getQueueSize() );
-    
     // create the workers and their threads
-    std::list< std::shared_ptr<Worker> > workers;
     int i;
     for( i=0; i< args.getMatcherThreads(); i++){
         std::shared_ptr<MatchWorker> worker = std::make_shared<MatchWorker>();
         worker->setQueue( queue );
         worker->setID( i );
         worker->setMatcher( matcher );
+        if( args.getOutputFile() != "" ){
+            // the colour frames are needed only for the output video
+            worker->enableOverlay();
+        }
         worker->start(); // start thread
         workers.push_back( worker );
     }
     // create the encode worker responsible for finding the maximum match and encoding the output video
     // this is done sequencially, so all frames are in the correct order again
-    std::shared_ptr<EncodeWorker> encodeWorker = std::make_shared<EncodeWorker>();
     encodeWorker->setQueue( queue );
     encodeWorker->setID( i++ );
-    encodeWorker->setImageCount( imageCount );
-    // the InputImages of the matcher of the encode worker 
-    // will be the only ones storing the current best match
-    encodeWorker->setMatcher( matcher );
-    workers.push_back( encodeWorker );
+    encodeWorker->setImageCount( matcher.getImageCount() );
+    // the encode worker is the only one storing the current best match
+    encodeWorker->setImages( matcher.getImages() );
 
     if( args.getOutputFile() != "" ){
         // enable encoding only if requested
         encodeWorker->enableEncode();
         encodeWorker->setOutputFile( args.getOutputFile() );
+        encodeWorker->setFrameRate( frameRate );
+    }
+    encodeWorker->start(); // start thread
+}
+
+int main(int argc, char **argv) {
+    /// parse arguments
+    Arguments args;
+    args.parseArgs( argc, argv );
+    args.printArguments();
+    std::printf( "distanceKernels: %s\n", DistanceKernels::getIsa().c_str() );
+    // create and configure the decoder
+    VideoDecoder dec;
+    configureDecoder( dec, args );
+    if( args.doKeyframeScan() || args.getDecoders() > 1 || args.getBenchmarkFrames() > 0 ){
+        // only probed for the dimensions and frame rate, no demuxer thread needed
+        dec.setReadAhead( 0 );
+    }
+    dec.openFile( args.getInputFile() );
+    if( args.hasTimeRange() ){
         try{
-            encodeWorker->setFrameRate( dec.getFrameRate() );
+            args.framesFromTimes( dec.getFrameRate() );
         }catch( VideoDecoderError& e ){
-            encodeWorker->setFrameRate( 25.0 );
+            std::cerr << "Time Range Error: " << e.what() << '\n';
+            return 1;
         }
+        std::printf( "time range -> minFrame: %d, maxFrame: %d\n", args.getMinFrame(), args.getMaxFrame() );
+    }
+    if( args.getBenchmarkFrames() > 0 ){
+        runBenchmark( args, dec.getWidth(), dec.getHeight() );
+        return 0;
     }
-    encodeWorker->start(); // start thread
 
-    int minFrame = args.getMinFrame();
-    int maxFrame = args.getMaxFrame();
-    while( 1 ){
-        // main loop decodign the frames
+    // the matcher will hold one image per search file
+    int imageCount = args.getSearchFiles().size();
+    double frameRate = 25.0;
+    try{
+        frameRate = dec.getFrameRate();
+    }catch( VideoDecoderError& e ){
+    }
 
-        if( queue->getTerminate() ){
-            // images found
-            break;
-        }
+    // create and configure the queue used by the workers to communicate
+    std::shared_ptr<WorkerQueue> queue = std::make_shared<WorkerQueue>();
+    queue->setImageCount( imageCount );
+    queue->setMaxLength( args.getQueueSize() );
+    queue->setReorderWindow( args.getReorderWindow() );
+    if( args.doRingQueue() ){
+        queue->doRingBuffer();
+    }
 
-        std::shared_ptr<VideoFrame> frame = std::make_shared<VideoFrame>();
+    // recycle the decoded frames: the queued frames plus one per matcher and decoder are in flight
+    std::shared_ptr<VideoFramePool> framePool = std::make_shared<VideoFramePool>();
+    framePool->setCapacity( args.getQueueSize() + args.getMatcherThreads() + args.getDecoders() );
+
+    // prepare the images and start the workers aside, the decoder fills the queue meanwhile
+    SurfMatcher matcher;
+    std::list< std::shared_ptr<Worker> > workers;
+    std::shared_ptr<EncodeWorker> encodeWorker = std::make_shared<EncodeWorker>();
+    int width = dec.getWidth();
+    int height = dec.getHeight();
+    std::thread setup( [&](){
+        startWorkers( args, matcher, width, height, frameRate, queue, workers, encodeWorker );
+    } );
+    // the decode workers follow the match and encode workers
+    int i = args.getMatcherThreads() + 1;
+
+    if( args.doKeyframeScan() || args.getDecoders() > 1 ){
+        // decode GOP aligned frame ranges by one or more decode workers
+        std::vector<long int> keyframes;
+        std::vector<bool> selected;
         try{
-            dec.decodeFrame( *frame );
+            if( args.doKeyframeScan() ){
+                // two phase search: keyframes first, then the candidate GOPs frame by frame. 
+                // Take the GOP before a candidate too, the matching shot may start there.
+                std::vector<bool> candidates;
+                // the scan needs the images
+                setup.join();
+                scanKeyframes( args, matcher, keyframes, candidates );
+                for( size_t k=0; k < keyframes.size(); k++ ){
+                    selected.push_back( candidates[k] || ( k+1 < keyframes.size() && candidates[k+1] ) );
+                }
+            }else{
+                // packet only prepass to find the GOPs
+                VideoDecoder scanDec;
+                scanDec.setIoBufferSize( args.getIoBufferSize() * 1024 );
+                scanDec.openFile( args.getInputFile() );
+                keyframes = scanDec.scanKeyframes();
+                selected.assign( keyframes.size(), true );
+            }
         }catch( VideoDecoderError& e ){
-            std::cerr << "Decode Error: " << e.what() << '\n';
-            queue->terminate();
-            break;
+            std::cerr << "Keyframe Scan Error: " << e.what() << '\n';
+        }
+        long int minLength = ( args.getDecoders() > 1 ) ? minSegmentLength : std::numeric_limits<long int>::max();
+        std::vector<FrameRange> ranges = gopRanges( args, keyframes, selected, minLength );
+        for( auto& range : ranges ){
+            queue->addFrameRange( range );
+        }
+        if( args.getDecoders() > 1 && args.getOutputFile() == "" ){
+            // otherwise the decoders would wait for each other's ranges. Not with an output 
+            // video: every buffered result holds a colour frame, the window stays small.
+            queue->setReorderWindow( rangesReorderWindow( args, ranges ) );
         }
 
-        if( frame->getIndex() >= minFrame ){
-            // skip the first decoded frames until minFrame is reached
-            queue->enqueue( frame );
+        std::list< std::shared_ptr<DecodeWorker> > decoders;
+        for( int d=0; d < args.getDecoders(); d++ ){
+            std::shared_ptr<DecodeWorker> decoder = std::make_shared<DecodeWorker>();
+            decoder->setQueue( queue );
+            decoder->setID( i++ );
+            decoder->setInputFile( args.getInputFile() );
+            configureDecoder( decoder->getDecoder(), args );
+            decoder->setFramePool( framePool );
+            decoder->start(); // start thread
+            decoders.push_back( decoder );
         }
-        if( frame->getIndex() >= maxFrame ){
-            // signal the worker threads to terminate, we are done!
-            queue->terminate();
-            break;
+        for ( auto &decoder : decoders ) {
+            decoder->join();
+        }
+        // let the match workers drain the queue
+        queue->finish();
+    }else{
+        int minFrame = args.getMinFrame();
+        int maxFrame = args.getMaxFrame();
+        // index of the next frame the queue waits for
+        long int next = minFrame;
+        if( minFrame > 0 ){
+            // jump to the keyframe before minFrame instead of decoding everything before it
+            try{
+                dec.seekFrame( minFrame );
+                queue->skipFrames( 0, minFrame );
+            }catch( VideoDecoderError& e ){
+                std::cerr << "Seek Error: " << e.what() << ", decoding from the start\n";
+            }
         }
+        while( 1 ){
+            // main loop decodign the frames
+
+            if( queue->getTerminate() ){
+                // images found
+                break;
+            }
+
+            std::shared_ptr<VideoFrame> frame = framePool->acquire();
+            try{
+                dec.decodeFrame( *frame );
+            }catch( VideoDecoderError& e ){
+                std::cerr << "Decode Error: " << e.what() << '\n';
+                queue->finish();
+                break;
+            }
+
+            long int index = frame->getIndex();
+            if( index >= minFrame ){
+                // skip the first decoded frames until minFrame is reached,
+                // the frames missing in between (e.g. a seek past minFrame) never come
+                queue->skipFrames( next, index );
+                queue->enqueue( frame );
+                next = std::max( next, index + 1 );
+            }
+            if( maxFrame >= 0 && index >= maxFrame ){
+                // signal the worker threads to finish, we are done!
+                queue->finish();
+                break;
+            }
+        }
+    }
+
+    if( setup.joinable() ){
+        setup.join();
     }
-    
     for ( auto &worker : workers ) {
-        // wait for all threads to terminate, especially the wencoder thread
+        // wait for the match workers to process all queued frames
         worker->join();
     }
+    // all matches are queued, let the encoder empty its queue and terminate
+    queue->terminate();
+    encodeWorker->join();
     // output the finalt sumary with all best matches
     encodeWorker->dumpBestMatch();
 }
@@ -2,9 +2,27 @@
 
 #include <vector>
 #include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <functional>
+#include <unistd.h>
 #include <opencv2/opencv.hpp>
 
 #include "../src/KdTree.h"
+#include "../src/KeyPointGrid.h"
+#include "../src/HitMask.h"
+#include "../src/TranslationVoter.h"
+#include "../src/DistanceKernels.h"
+#include "../src/InvertedGridIndex.h"
+#include "../src/KeyPointCache.h"
+#include "../src/TaskPool.h"
+#include "../src/VideoFrame.h"
+#include "../src/FrameRing.h"
+#include "../src/WorkerQueue.h"
 
 struct point{
     int x;
@@ -49,6 +67,317 @@ TEST_F(KdTest, nearestNeighborSearch) {
     EXPECT_EQ( nnExp.y , nn.pt.y);
 }
 
+TEST_F(KdTest, nearestNeighborSearchBruteForce) {
+    KdTree tree = KdTree( this->keypoints );
+    EXPECT_EQ( (int) this->keypoints.size(), tree.size() );
+
+    for( int y = -5; y < 55; y++ ){
+        for( int x = -5; x < 55; x++ ){
+            double best = -1;
+            for( auto& kp : this->keypoints ){
+                double d = (kp.pt.x-x)*(kp.pt.x-x) + (kp.pt.y-y)*(kp.pt.y-y);
+                if( best < 0 || d < best ){
+                    best = d;
+                }
+            }
+            // ties may resolve to any of the closest points
+            cv::KeyPoint nn = tree.nearestNeighborSearch( x, y );
+            double d = (nn.pt.x-x)*(nn.pt.x-x) + (nn.pt.y-y)*(nn.pt.y-y);
+            EXPECT_EQ( best, d );
+        }
+    }
+}
+
+TEST_F(KdTest, countWithin) {
+    KdTree tree = KdTree( this->keypoints );
+
+    // (48,11) is in the set twice, (48,13) is at distance 2
+    EXPECT_EQ( 2, tree.countWithin( 48, 11, 1.0 ) );
+    EXPECT_EQ( 2, tree.countWithin( 48, 11, 2.0 ) );
+    EXPECT_EQ( 3, tree.countWithin( 48, 11, 2.5 ) );
+    EXPECT_TRUE( tree.hasNeighborWithin( 11, 9, 1.5 ) );
+    EXPECT_FALSE( tree.hasNeighborWithin( 11, 9, 1.0 ) );
+
+    for( double r = 0.5; r < 8; r += 1.5 ){
+        for( int y = -5; y < 55; y++ ){
+            for( int x = -5; x < 55; x++ ){
+                int count = 0;
+                for( auto& kp : this->keypoints ){
+                    double d = (kp.pt.x-x)*(kp.pt.x-x) + (kp.pt.y-y)*(kp.pt.y-y);
+                    if( d < r*r ){
+                        count++;
+                    }
+                }
+                EXPECT_EQ( count, tree.countWithin( x, y, r ) );
+                EXPECT_EQ( count > 0, tree.hasNeighborWithin( x, y, r ) );
+            }
+        }
+    }
+}
+
+TEST_F(KdTest, gridMatchesKdTree) {
+    KdTree tree = KdTree( this->keypoints );
+
+    for( double cell = 1.0; cell < 12; cell += 2.5 ){
+        KeyPointGrid grid = KeyPointGrid( this->keypoints, cell );
+        EXPECT_EQ( tree.size(), grid.size() );
+
+        for( int y = -10; y < 60; y++ ){
+            for( int x = -10; x < 60; x++ ){
+                // the match radius is the cell size, but other radii must work too
+                for( double r = cell / 2; r <= cell * 2; r += cell / 2 ){
+                    EXPECT_EQ( tree.countWithin( x, y, r ), grid.countWithin( x, y, r ) );
+                    EXPECT_EQ( tree.hasNeighborWithin( x, y, r ), grid.hasNeighborWithin( x, y, r ) );
+                }
+                // ties may resolve to different points of the same distance
+                cv::KeyPoint a = tree.nearestNeighborSearch( x, y );
+                cv::KeyPoint b = grid.nearestNeighborSearch( x, y );
+                EXPECT_EQ( (a.pt.x-x)*(a.pt.x-x) + (a.pt.y-y)*(a.pt.y-y), 
+                           (b.pt.x-x)*(b.pt.x-x) + (b.pt.y-y)*(b.pt.y-y) );
+            }
+        }
+    }
+}
+
+TEST_F(KdTest, gridCellLimit) {
+    // a tiny cell size on a sparse set must not allocate a cell per pixel
+    KeyPointGrid grid = KeyPointGrid( this->keypoints, 0.001 );
+    EXPECT_LE( (long int) grid.getColumns() * grid.getRows(), (long int) KeyPointGrid::minCellLimit );
+    EXPECT_EQ( 2, grid.countWithin( 48, 11, 1.0 ) );
+
+    KeyPointGrid exact = KeyPointGrid( this->keypoints, 5.0 );
+    EXPECT_EQ( 5.0, exact.getCellSize() );
+}
+
+TEST_F(KdTest, hitMaskMatchesKdTree) {
+    KdTree tree = KdTree( this->keypoints );
+
+    for( double r = 0.5; r < 8; r += 1.5 ){
+        HitMask mask = HitMask( this->keypoints, r );
+        // exact on whole pixels, fractional positions are rounded
+        for( int y = -10; y < 60; y++ ){
+            for( int x = -10; x < 60; x++ ){
+                EXPECT_EQ( tree.hasNeighborWithin( x, y, r ), mask.test( x, y ) );
+                EXPECT_EQ( tree.hasNeighborWithin( x, y, r ), mask.test( x + 0.3f, y - 0.3f ) );
+            }
+        }
+    }
+}
+
+TEST(TranslationVoterTest, houghMatchesPairwise) {
+    TranslationVoter voter;
+    std::srand( 42 );
+    for( int run = 0; run < 200; run++ ){
+        voter.setRadius( 1 + run % 7 );
+        // a shifted copy of some keypoints plus random pairs
+        std::vector<cv::KeyPoint> keypoints;
+        std::vector<cv::KeyPoint> nearest;
+        int shiftX = std::rand() % 41 - 20;
+        int shiftY = std::rand() % 41 - 20;
+        int n = std::rand() % 120;
+        for( int i = 0; i < n; i++ ){
+            cv::KeyPoint kp;
+            cv::KeyPoint nn;
+            kp.pt.x = std::rand() % 640 + ( run % 2 ) * 0.25f * ( std::rand() % 4 );
+            kp.pt.y = std::rand() % 480 + ( run % 2 ) * 0.25f * ( std::rand() % 4 );
+            if( std::rand() % 3 ){
+                nn.pt.x = kp.pt.x + shiftX + std::rand() % 5 - 2;
+                nn.pt.y = kp.pt.y + shiftY + std::rand() % 5 - 2;
+            }else{
+                nn.pt.x = std::rand() % 640;
+                nn.pt.y = std::rand() % 480;
+            }
+            keypoints.push_back( kp );
+            nearest.push_back( nn );
+        }
+        int votesInit = std::rand() % ( n/2 + 1 );
+        std::vector<float> offsetX;
+        std::vector<float> offsetY;
+        TranslationVoter::getOffsets( keypoints, nearest, offsetX, offsetY );
+        std::vector<int> pairwise = {0,0};
+        std::vector<int> hough = {0,0};
+        int pairwiseVotes = voter.votePairwise( offsetX, offsetY, votesInit, pairwise );
+        int houghVotes = voter.voteHough( offsetX, offsetY, votesInit, hough );
+        EXPECT_EQ( pairwiseVotes, houghVotes );
+        EXPECT_EQ( pairwise[0], hough[0] );
+        EXPECT_EQ( pairwise[1], hough[1] );
+    }
+}
+
+TEST(TranslationVoterTest, translationTable) {
+    TranslationTable table( 3 );
+    int tx, ty, votes;
+    EXPECT_FALSE( table.load( 0, tx, ty, votes ) );
+
+    table.store( 1, -12, 345, 0 );
+    table.store( 2, 640, -480, 123456 );
+    EXPECT_FALSE( table.load( 0, tx, ty, votes ) );
+    EXPECT_TRUE( table.load( 1, tx, ty, votes ) );
+    EXPECT_EQ( -12, tx );
+    EXPECT_EQ( 345, ty );
+    EXPECT_EQ( 0, votes );
+    EXPECT_TRUE( table.load( 2, tx, ty, votes ) );
+    EXPECT_EQ( 640, tx );
+    EXPECT_EQ( -480, ty );
+    EXPECT_EQ( 123456, votes );
+}
+
+TEST(TranslationVoterTest, translationSeed) {
+    // 10 pairs at offset (5,5), 30 pairs far apart
+    std::vector<float> offsetX( 10, 5.0f );
+    std::vector<float> offsetY( 10, 5.0f );
+    for( int i=0; i < 30; i++ ){
+        offsetX.push_back( 100.0f + i*20 );
+        offsetY.push_back( -100.0f );
+    }
+    float radius2 = 4.0f;
+    TranslationTable table( 1 );
+    std::vector<int> best = {0,0};
+    int tx, ty, votes;
+    EXPECT_EQ( -1, table.trySeed( 0, offsetX, offsetY, radius2, 0, best ) );
+
+    // kept, beats no translation
+    table.store( 0, 5, 5, 10 );
+    EXPECT_EQ( 10, table.trySeed( 0, offsetX, offsetY, radius2, 2, best ) );
+    EXPECT_EQ( 5, best[0] );
+    EXPECT_EQ( 5, best[1] );
+
+    // rejected, far below the votes of the last frame
+    table.store( 0, 5, 5, 20 );
+    EXPECT_EQ( -1, table.trySeed( 0, offsetX, offsetY, radius2, 2, best ) );
+
+    // kept but no better than no translation: the table follows what was used
+    best = {0,0};
+    table.store( 0, 5, 5, 10 );
+    EXPECT_EQ( 12, table.trySeed( 0, offsetX, offsetY, radius2, 12, best ) );
+    EXPECT_EQ( 0, best[0] );
+    EXPECT_EQ( 0, best[1] );
+    EXPECT_TRUE( table.load( 0, tx, ty, votes ) );
+    EXPECT_EQ( 0, tx );
+    EXPECT_EQ( 0, ty );
+    EXPECT_EQ( 12, votes );
+
+    // rejected, too few of the frame keypoints agree
+    for( int i=0; i < 20; i++ ){
+        offsetX.push_back( -300.0f - i*20 );
+        offsetY.push_back( 100.0f );
+    }
+    table.store( 0, 5, 5, 10 );
+    EXPECT_EQ( -1, table.trySeed( 0, offsetX, offsetY, radius2, 0, best ) );
+}
+
+TEST(DistanceKernelsTest, kernelsAgree) {
+    std::srand( 7 );
+    std::vector<float> xs;
+    std::vector<float> ys;
+    for( int i = 0; i < 1000; i++ ){
+        xs.push_back( ( std::rand() % 20000 ) / 100.0f - 100 );
+        ys.push_back( ( std::rand() % 20000 ) / 100.0f - 100 );
+    }
+    for( int run = 0; run < 500; run++ ){
+        // odd lengths and offsets exercise the scalar tails
+        int begin = std::rand() % 20;
+        int n = std::rand() % ( xs.size() - begin );
+        float cx = ( std::rand() % 2000 ) / 10.0f - 100;
+        float cy = ( std::rand() % 2000 ) / 10.0f - 100;
+        float r = ( std::rand() % 300 ) / 10.0f;
+        int expected = 0;
+        for( int i = begin; i < begin+n; i++ ){
+            float dx = xs[i] - cx;
+            float dy = ys[i] - cy;
+            if( dx*dx + dy*dy < r*r ){
+                expected++;
+            }
+        }
+        EXPECT_EQ( expected, DistanceKernels::countWithinScalar( xs.data()+begin, ys.data()+begin, n, cx, cy, r*r ) );
+        EXPECT_EQ( expected, DistanceKernels::countWithin( xs.data()+begin, ys.data()+begin, n, cx, cy, r*r ) );
+        if( DistanceKernels::hasSse2() ){
+            EXPECT_EQ( expected, DistanceKernels::countWithinSse2( xs.data()+begin, ys.data()+begin, n, cx, cy, r*r ) );
+        }
+        if( DistanceKernels::hasAvx2() ){
+            EXPECT_EQ( expected, DistanceKernels::countWithinAvx2( xs.data()+begin, ys.data()+begin, n, cx, cy, r*r ) );
+        }
+    }
+}
+
+TEST_F(KdTest, invertedGridMatchesKdTrees) {
+    // the test points split into three images, frame keypoints on a regular lattice
+    std::vector< std::vector<cv::KeyPoint> > images( 3 );
+    for( int i = 0; i < this->keypoints.size(); i++ ){
+        images[ i % 3 ].push_back( this->keypoints[i] );
+    }
+    std::vector<cv::KeyPoint> frame;
+    for( int y = -4; y < 56; y += 3 ){
+        for( int x = -4; x < 56; x += 2 ){
+            cv::KeyPoint kp;
+            kp.pt.x = x + 0.5f;
+            kp.pt.y = y;
+            frame.push_back( kp );
+        }
+    }
+
+    for( double r = 1.0; r < 8; r += 2.5 ){
+        InvertedGridIndex index( r );
+        for( int i = 0; i < images.size(); i++ ){
+            index.addImage( i, images[i] );
+        }
+        index.build();
+        EXPECT_EQ( (int) this->keypoints.size(), index.size() );
+
+        std::vector<int> hits;
+        std::vector<int> scratch;
+        index.countHits( frame, r, hits, scratch );
+        EXPECT_EQ( 3, (int) hits.size() );
+        for( int i = 0; i < images.size(); i++ ){
+            KdTree tree = KdTree( images[i] );
+            int expected = 0;
+            for( auto& kp : frame ){
+                if( tree.hasNeighborWithin( kp.pt.x, kp.pt.y, r ) ){
+                    expected++;
+                }
+            }
+            EXPECT_EQ( expected, hits[i] );
+        }
+    }
+}
+
+TEST_F(KdTest, keyPointCacheRoundTrip) {
+    char directory[] = "/tmp/testKdCacheXXXXXX";
+    ASSERT_TRUE( mkdtemp( directory ) != NULL );
+    KeyPointCache cache( directory );
+    std::string content = "image file content";
+    uint64_t key = KeyPointCache::hash( content.data(), content.size() );
+    EXPECT_NE( key, KeyPointCache::hash( content.data(), content.size() - 1 ) );
+
+    // store in tree order and load without building
+    KdTree tree = KdTree( this->keypoints );
+    std::vector<cv::KeyPoint> ordered;
+    for( int i = 0; i < tree.size(); i++ ){
+        ordered.push_back( tree.getKeyPoint( i ) );
+    }
+    ordered[0].octave = 3;
+    ordered[0].response = 0.25f;
+    ASSERT_TRUE( cache.store( key, ordered, true ) );
+
+    std::vector<cv::KeyPoint> loaded;
+    bool treeOrder = false;
+    ASSERT_TRUE( cache.load( key, loaded, treeOrder ) );
+    EXPECT_TRUE( treeOrder );
+    ASSERT_EQ( ordered.size(), loaded.size() );
+    EXPECT_EQ( 3, loaded[0].octave );
+    EXPECT_EQ( 0.25f, loaded[0].response );
+    EXPECT_FALSE( cache.load( key + 1, loaded, treeOrder ) );
+
+    KdTree prebuilt = KdTree( loaded, true );
+    for( int y = -2; y < 52; y += 3 ){
+        for( int x = -2; x < 52; x += 3 ){
+            EXPECT_EQ( tree.nearestNeighborIndex( x, y ), prebuilt.nearestNeighborIndex( x, y ) );
+        }
+    }
+    std::remove( cache.getPath( key ).c_str() );
+    rmdir( directory );
+}
+
 TEST_F(KdTest, compareKeyPointByX) {
     cv::KeyPoint a;
     cv::KeyPoint b;
@@ -73,6 +402,345 @@ TEST_F(KdTest, compareKeyPointByY) {
     EXPECT_FALSE( KdTree::compareKeyPointByY( b, a ) );
 }
 
+TEST(TaskPoolTest, concurrentBatches) {
+    // several callers share the pool and help with each other's tasks
+    TaskPool pool( 3 );
+    std::atomic<int> errors( 0 );
+    std::vector<std::thread> callers;
+    for( int c = 0; c < 4; c++ ){
+        callers.push_back( std::thread( [&pool, &errors, c](){
+            for( int batch = 0; batch < 300; batch++ ){
+                int count = 1 + ( batch + c ) % 9;
+                std::vector< std::atomic<int> > runs( count );
+                for( auto& r : runs ){
+                    r = 0;
+                }
+                pool.run( count, [&runs]( int task ){
+                    runs[task]++;
+                } );
+                for( auto& r : runs ){
+                    if( r != 1 ){
+                        errors++;
+                    }
+                }
+            }
+        } ) );
+    }
+    for( auto& t : callers ){
+        t.join();
+    }
+    EXPECT_EQ( 0, errors.load() );
+}
+
+TEST(TaskPoolTest, exceptionPropagates) {
+    TaskPool pool( 2 );
+    for( int batch = 0; batch < 50; batch++ ){
+        std::vector< std::atomic<int> > runs( 6 );
+        for( auto& r : runs ){
+            r = 0;
+        }
+        EXPECT_THROW( pool.run( 6, [&runs]( int task ){
+            runs[task]++;
+            if( task == 3 ){
+                throw std::runtime_error( "task failed" );
+            }
+        } ), std::runtime_error );
+        // the other tasks of the batch still ran, once
+        for( auto& r : runs ){
+            EXPECT_EQ( 1, r.load() );
+        }
+    }
+    // the pool is still usable
+    std::atomic<int> sum( 0 );
+    pool.run( 4, [&sum]( int task ){
+        sum += task;
+    } );
+    EXPECT_EQ( 6, sum.load() );
+}
+
+TEST(FrameRingTest, pushPop) {
+    FrameRing ring( 2 );
+    EXPECT_TRUE( ring.empty() );
+    std::shared_ptr<VideoFrame> frame;
+    EXPECT_FALSE( ring.pop( frame ) );
+    for( int i = 0; i < 3; i++ ){
+        std::shared_ptr<VideoFrame> f = std::make_shared<VideoFrame>();
+        f->setIndex( i );
+        EXPECT_EQ( i < 2, ring.push( f ) );
+    }
+    EXPECT_TRUE( ring.full() );
+    ASSERT_TRUE( ring.pop( frame ) );
+    EXPECT_EQ( 0, frame->getIndex() );
+    ASSERT_TRUE( ring.pop( frame ) );
+    EXPECT_EQ( 1, frame->getIndex() );
+    EXPECT_TRUE( ring.empty() );
+}
+
+TEST(FrameRingTest, concurrentProducersConsumers) {
+    // every frame is delivered exactly once, in push order per producer and consumer
+    const int producers = 3;
+    const int consumers = 3;
+    const int frames = 20000;
+    FrameRing ring( 4 );
+    std::vector< std::atomic<int> > seen( producers * frames );
+    for( auto& s : seen ){
+        s = 0;
+    }
+    std::atomic<int> popped( 0 );
+    std::atomic<int> errors( 0 );
+    std::vector<std::thread> threads;
+    for( int p = 0; p < producers; p++ ){
+        threads.push_back( std::thread( [&ring, p, frames](){
+            for( int i = 0; i < frames; i++ ){
+                std::shared_ptr<VideoFrame> f = std::make_shared<VideoFrame>();
+                f->setIndex( p * frames + i );
+                while( ! ring.push( f ) ){
+                    std::this_thread::yield();
+                }
+            }
+        } ) );
+    }
+    for( int c = 0; c < consumers; c++ ){
+        threads.push_back( std::thread( [&](){
+            std::vector<long int> last( producers, -1 );
+            std::shared_ptr<VideoFrame> f;
+            while( popped < producers * frames ){
+                if( ! ring.pop( f ) ){
+                    std::this_thread::yield();
+                    continue;
+                }
+                popped++;
+                long int index = f->getIndex();
+                seen[index]++;
+                if( index <= last[index / frames] ){
+                    errors++;
+                }
+                last[index / frames] = index;
+            }
+        } ) );
+    }
+    for( auto& t : threads ){
+        t.join();
+    }
+    EXPECT_EQ( 0, errors.load() );
+    EXPECT_TRUE( ring.empty() );
+    for( auto& s : seen ){
+        EXPECT_EQ( 1, s.load() );
+    }
+}
+
+TEST(FrameRingTest, queueSleepWake) {
+    // blocking enqueue and dequeue of the queue on a small ring, the threads sleep on full and empty
+    const int producers = 2;
+    const int frames = 5000;
+    WorkerQueue queue;
+    queue.setMaxLength( 2 );
+    queue.setImageCount( 1 );
+    // no encoder moves the reorder window here
+    queue.setReorderWindow( producers * frames );
+    queue.doRingBuffer();
+
+    std::vector< std::atomic<int> > seen( producers * frames );
+    for( auto& s : seen ){
+        s = 0;
+    }
+    std::vector<std::thread> producerThreads;
+    for( int p = 0; p < producers; p++ ){
+        producerThreads.push_back( std::thread( [&queue, p, frames](){
+            for( int i = 0; i < frames; i++ ){
+                std::shared_ptr<VideoFrame> f = std::make_shared<VideoFrame>();
+                f->setIndex( i * 2 + p );
+                queue.enqueue( f );
+                if( i % 500 == 0 ){
+                    // let the consumers run dry
+                    std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+                }
+            }
+        } ) );
+    }
+    std::vector<std::thread> consumerThreads;
+    for( int c = 0; c < 3; c++ ){
+        consumerThreads.push_back( std::thread( [&queue, &seen](){
+            while( std::shared_ptr<VideoFrame> f = queue.dequeue() ){
+                seen[ f->getIndex() ]++;
+            }
+        } ) );
+    }
+    for( auto& t : producerThreads ){
+        t.join();
+    }
+    queue.finish();
+    for( auto& t : consumerThreads ){
+        t.join();
+    }
+    for( auto& s : seen ){
+        EXPECT_EQ( 1, s.load() );
+    }
+}
+
+// match worker of the queue tests: one result per frame, no matching
+void matchFrames( WorkerQueue* queue ){
+    while( std::shared_ptr<VideoFrame> frame = queue->dequeue() ){
+        std::shared_ptr<FrameResult> result = std::make_shared<FrameResult>( 1 );
+        result->setFrameIndex( frame->getIndex() );
+        queue->enqueueResult( result );
+    }
+}
+
+// runs the pipeline, terminates the queue if it does not finish in time
+bool finishesInTime( WorkerQueue& queue, std::function<void()> pipeline ){
+    std::future<void> run = std::async( std::launch::async, pipeline );
+    if( run.wait_for( std::chrono::seconds( 30 ) ) != std::future_status::ready ){
+        queue.terminate();
+        run.wait();
+        return false;
+    }
+    return true;
+}
+
+TEST(ReorderWindowTest, rangesWithGapsAndErrors) {
+    // two decoders on GOP ranges: a frame the decoder never returns (100-104),
+    // a gap between the ranges (300-319) and a decode error mid-range (450)
+    WorkerQueue queue;
+    queue.setMaxLength( 3 );
+    queue.setImageCount( 1 );
+    queue.setReorderWindow( 8 );
+    queue.addFrameRange( FrameRange( 0, 300 ) );
+    queue.addFrameRange( FrameRange( 320, 600 ) );
+    queue.addFrameRange( FrameRange( 600, 900 ) );
+
+    std::vector<long int> delivered;
+    bool done = finishesInTime( queue, [&](){
+        std::vector<std::thread> decoders;
+        for( int d = 0; d < 2; d++ ){
+            decoders.push_back( std::thread( [&queue](){
+                FrameRange range;
+                while( queue.dequeueFrameRange( range ) ){
+                    long int next = range.first;
+                    for( long int i = range.first; i < range.second; i++ ){
+                        if( i >= 100 && i < 105 ){
+                            continue;
+                        }
+                        if( i == 450 ){
+                            queue.skipFrames( next, range.second );
+                            break;
+                        }
+                        std::shared_ptr<VideoFrame> frame = std::make_shared<VideoFrame>();
+                        frame->setIndex( i );
+                        queue.skipFrames( next, i );
+                        queue.enqueue( frame );
+                        next = i + 1;
+                    }
+                }
+            } ) );
+        }
+        std::vector<std::thread> workers;
+        for( int w = 0; w < 3; w++ ){
+            workers.push_back( std::thread( matchFrames, &queue ) );
+        }
+        std::thread encoder( [&](){
+            while( std::shared_ptr<FrameResult> result = queue.dequeueResult() ){
+                delivered.push_back( result->getFrameIndex() );
+            }
+        } );
+        for( auto& t : decoders ){
+            t.join();
+        }
+        queue.finish();
+        for( auto& t : workers ){
+            t.join();
+        }
+        queue.terminate();
+        encoder.join();
+    } );
+    EXPECT_TRUE( done );
+
+    std::vector<long int> expected;
+    for( long int i = 0; i < 900; i++ ){
+        if( ( i >= 100 && i < 105 ) || ( i >= 300 && i < 320 ) || ( i >= 450 && i < 600 ) ){
+            continue;
+        }
+        expected.push_back( i );
+    }
+    EXPECT_TRUE( expected == delivered );
+}
+
+TEST(ReorderWindowTest, seekPastFirstFrame) {
+    // the seek to frame 100 lands on frame 103, far more frames than the window follow
+    WorkerQueue queue;
+    queue.setMaxLength( 3 );
+    queue.setImageCount( 1 );
+    queue.setReorderWindow( 4 );
+    queue.skipFrames( 0, 100 );
+
+    long int count = 0;
+    long int last = -1;
+    bool ordered = true;
+    bool done = finishesInTime( queue, [&](){
+        std::thread worker( matchFrames, &queue );
+        std::thread encoder( [&](){
+            while( std::shared_ptr<FrameResult> result = queue.dequeueResult() ){
+                ordered = ordered && result->getFrameIndex() > last;
+                last = result->getFrameIndex();
+                count++;
+            }
+        } );
+        long int next = 100;
+        for( long int i = 103; i < 200; i++ ){
+            std::shared_ptr<VideoFrame> frame = std::make_shared<VideoFrame>();
+            frame->setIndex( i );
+            queue.skipFrames( next, i );
+            queue.enqueue( frame );
+            next = i + 1;
+        }
+        queue.finish();
+        worker.join();
+        queue.terminate();
+        encoder.join();
+    } );
+    EXPECT_TRUE( done );
+    EXPECT_TRUE( ordered );
+    EXPECT_EQ( 97, count );
+}
+
+TEST(ReorderWindowTest, terminateFlushesInOrder) {
+    // frame 5 is lost without being skipped, terminate flushes the rest in order
+    WorkerQueue queue;
+    queue.setMaxLength( 3 );
+    queue.setImageCount( 1 );
+    queue.setReorderWindow( 16 );
+
+    std::vector<long int> delivered;
+    bool done = finishesInTime( queue, [&](){
+        std::vector<std::thread> workers;
+        for( int w = 0; w < 2; w++ ){
+            workers.push_back( std::thread( matchFrames, &queue ) );
+        }
+        std::thread encoder( [&](){
+            while( std::shared_ptr<FrameResult> result = queue.dequeueResult() ){
+                delivered.push_back( result->getFrameIndex() );
+            }
+        } );
+        for( long int i = 0; i < 10; i++ ){
+            if( i == 5 ){
+                continue;
+            }
+            std::shared_ptr<VideoFrame> frame = std::make_shared<VideoFrame>();
+            frame->setIndex( i );
+            queue.enqueue( frame );
+        }
+        queue.finish();
+        for( auto& t : workers ){
+            t.join();
+        }
+        queue.terminate();
+        encoder.join();
+    } );
+    EXPECT_TRUE( done );
+    std::vector<long int> expected = { 0, 1, 2, 3, 4, 6, 7, 8, 9 };
+    EXPECT_TRUE( expected == delivered );
+}
+
 int main(int argc, char **argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();